@@ -1,4 +1,5 @@
 
+#include <stdexcept>
 #include <vector>
 #include "expected_sarsa_agent.hpp"
 
@@ -20,12 +21,13 @@ void ExpectedSarsaAgent::agent_init(const AgentInit& params)
     discount = params.discount;
     seed = params.seed;
 
+    if (num_actions > max_actions)
+        throw(std::out_of_range("ExpectedSarsaAgent: too many actions"));
+
     prev_state = 0;
     prev_action = 0;
 
-    gen = std::mt19937(seed);
-    rand_real = std::uniform_real_distribution<>(0, 1);
-    rand_int = std::uniform_int_distribution<>(0, num_actions-1);
+    gen = rng::make_engine(seed, params.run, rng::agent_stream);
 
     // Create an array for action-value estimates and initialize it to zero.
     Float2D::extent_gen extents;
@@ -51,8 +53,8 @@ Action ExpectedSarsaAgent::agent_start(const State state)
 
     // Choose action using epsilon greedy
     Action action{0};
-    if (rand_real(gen) < epsilon)
-        action = rand_int(gen);
+    if (rng::bernoulli(gen, epsilon))
+        action = rng::uniform_int(gen, num_actions);
     else
         std::tie(action, std::ignore) = argmax(current_q);
 
@@ -85,8 +87,8 @@ Action ExpectedSarsaAgent::agent_step(const float reward, const State state)
     // Choose action using epsilon greedy
     Action action{0};
     float q_max{0};
-    if (rand_real(gen) < epsilon)
-        action = rand_int(gen);
+    if (rng::bernoulli(gen, epsilon))
+        action = rng::uniform_int(gen, num_actions);
     else
         std::tie(action, q_max) = argmax(current_q);
 
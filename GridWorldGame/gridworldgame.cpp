@@ -2,14 +2,16 @@
 #include <array>
 #include <chrono>
 #include <cstdio>
-#include <fstream>
 #include <map>
 #include <memory>
 #include <iostream>
 #include <numeric>
+#include <string>
 #include <vector>
 
 #include "rl.hpp"
+#include "result_file.hpp"
+#include "run_executor.hpp"
 #include "gridworldgame_environment.hpp"
 #include "expected_sarsa_agent.hpp"
 #include "q_learning_agent.hpp"
@@ -25,56 +27,57 @@ int main()
     constexpr unsigned int num_runs = 100;
     constexpr unsigned int num_episodes = 250;
 
-    const std::map<std::string, std::shared_ptr<Agent>> agents {
-        { "Expected Sarsa", std::make_shared<ExpectedSarsaAgent>() },
-        { "Q Learning", std::make_shared<QLearningAgent>() },
-    };
-
     std::map<std::string, std::array<std::array<float, num_runs>, num_episodes>> all_returns;
-    std::vector<float> avg_returns(num_episodes);
-
-    std::shared_ptr<Environment> env = std::make_shared<GridWorldGameEnvironment>();
 
     AgentInit agent_params{4, 250, 0.1, 0.1, 0.8, 0};
     EnvironmentInit env_params;
 
-    auto begin = std::chrono::steady_clock::now();
-    for (auto agent : agents)
+    // The runs of each agent spread over the cores, each with an agent and
+    // environment of its own
+    auto make_env = []() { return std::make_shared<GridWorldGameEnvironment>(); };
+    auto run_agent = [&](const std::string& name, RunExecutor::AgentFactory make_agent)
     {
-        for (unsigned int run=0; run < num_runs; ++run)
+        auto& returns = all_returns[name];
+        RunExecutor executor(make_env, make_agent);
+        executor.run(num_runs, env_params, agent_params, [&](RL& rl, const unsigned int run)
         {
-            agent_params.seed = run;
-            RL rl(env, agent.second);
-            rl.rl_init(env_params, agent_params);
-
             for (unsigned int episode=0; episode < num_episodes; ++episode)
             {
                 rl.rl_episode(0);
-                all_returns[agent.first][episode][run] = rl.rl_return();
+                returns[episode][run] = rl.rl_return();
             }
-        }
+        });
+        return executor.get_num_threads();
+    };
 
-    }
+    auto begin = std::chrono::steady_clock::now();
+    run_agent("Expected Sarsa", []() { return std::make_shared<ExpectedSarsaAgent>(); });
+    unsigned int num_threads = run_agent("Q Learning", []() { return std::make_shared<QLearningAgent>(); });
 
     auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double> diff = end - begin;
-    std::printf("%5.2f it/s, %4.3f s/it, (total %f)\n", num_runs/diff.count(), diff.count()/num_runs, diff.count());
-
-    std::ofstream f;
-    f.open ("avg_returns.txt");
-
-    for (unsigned int episode=0; episode < num_episodes; ++episode)
+    std::printf("%u threads, %5.2f it/s, %4.3f s/it, (total %f)\n",
+            num_threads, num_runs/diff.count(), diff.count()/num_runs, diff.count());
+
+    // avg_returns.bin: a row of average returns per agent, the agents named
+    // in the header, see result_file.hpp
+    std::vector<float> avg_returns(all_returns.size() * num_episodes);
+    ResultFile results;
+    results.set_config("num_runs", std::to_string(num_runs));
+    std::size_t row = 0;
+    for (const auto& agent : all_returns)
     {
-        for (auto agent : agents)
+        std::printf("%s\n", agent.first.c_str());
+        results.set_config("agent_" + std::to_string(row), agent.first);
+        for (unsigned int episode=0; episode < num_episodes; ++episode)
         {
-            if(episode == 0) std::printf("%s\n", agent.first.c_str());
-            float sum = std::accumulate(all_returns[agent.first][episode].cbegin(), all_returns[agent.first][episode].cend(), 0);
-            avg_returns[episode] = sum / num_runs;
-            f << sum / num_runs << " ";
+            float sum = std::accumulate(agent.second[episode].cbegin(), agent.second[episode].cend(), 0.0f);
+            avg_returns[row * num_episodes + episode] = sum / num_runs;
         }
-        f << std::endl;
+        ++row;
     }
-    f.close();
+    results.add_column("avg_returns", {all_returns.size(), num_episodes}, avg_returns.data());
+    results.write("avg_returns.bin");
 
     std::printf("%s: done\n", __func__);
 
@@ -0,0 +1,66 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "rl.hpp"
+#include "gridworldgame_environment.hpp"
+#include "q_learning_agent.hpp"
+
+using namespace rl;
+using namespace env;
+using namespace agent;
+
+/* Seconds taken by num_runs runs of num_episodes episodes through rl */
+template <class Loop>
+double seconds(Loop& rl, const EnvironmentInit& env_params, AgentInit agent_params,
+               const unsigned int num_runs, const unsigned int num_episodes)
+{
+    auto tic = std::chrono::steady_clock::now();
+    for (unsigned int run=0; run < num_runs; ++run)
+    {
+        agent_params.run = run;
+        rl.rl_init(env_params, agent_params);
+        for (unsigned int episode=0; episode < num_episodes; ++episode)
+            rl.rl_episode(0);
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+    return diff.count();
+}
+
+/* Times the same seeded runs of Q-learning through RL, which calls the agent
+ * and the environment through their virtual interfaces, and through
+ * StaticRL, which binds them at compile time. The two are timed in turn, and
+ * the best of the repeats of each is reported:
+ *
+ *     GridWorldGameBenchmark [num_runs [num_episodes [num_repeats]]]
+ */
+int main(int argc, char* argv[])
+{
+    if (argc > 4)
+    {
+        std::fprintf(stderr, "usage: %s [num_runs [num_episodes [num_repeats]]]\n", argv[0]);
+        return 1;
+    }
+    const unsigned int num_runs = argc > 1 ? std::stoul(argv[1]) : 10;
+    const unsigned int num_episodes = argc > 2 ? std::stoul(argv[2]) : 250;
+    const unsigned int num_repeats = argc > 3 ? std::stoul(argv[3]) : 5;
+
+    AgentInit agent_params{4, 250, 0.1, 0.1, 0.8, 0};
+    EnvironmentInit env_params;
+
+    RL virtual_rl(std::make_shared<GridWorldGameEnvironment>(), std::make_shared<QLearningAgent>());
+    StaticRL<GridWorldGameEnvironment, QLearningAgent> static_rl;
+    double virtual_time{0}, static_time{0};
+    for (unsigned int repeat=0; repeat < num_repeats; ++repeat)
+    {
+        double t = seconds(virtual_rl, env_params, agent_params, num_runs, num_episodes);
+        virtual_time = repeat ? std::min(virtual_time, t) : t;
+        t = seconds(static_rl, env_params, agent_params, num_runs, num_episodes);
+        static_time = repeat ? std::min(static_time, t) : t;
+    }
+    std::printf("%u runs of %u episodes, best of %u: RL %4.3f s, StaticRL %4.3f s (%.2fx)\n",
+            num_runs, num_episodes, num_repeats, virtual_time, static_time, virtual_time / static_time);
+}
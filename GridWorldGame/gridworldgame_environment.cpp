@@ -1,25 +1,60 @@
 
 #include <stdexcept>
-#include <type_traits>
 #include "gridworldgame_environment.hpp"
 
 using namespace rl;
 using namespace env;
 
-void GridWorldGameEnvironment::env_init(const EnvironmentInit params)
+/* Moving right, down, left or up from each cell; moves into the outer walls
+ * or the internal wall right of (0, 0), (1, 0) and (1, 1) are penalized and
+ * leave the agent where it was.
+ */
+constexpr std::array<GridWorldGameEnvironment::Transition, GridWorldGameEnvironment::num_cells *
+                     GridWorldGameEnvironment::num_actions> GridWorldGameEnvironment::make_transitions()
 {
-    if (std::is_empty<EnvironmentInit>::value)
-        (void)params;
+    std::array<Transition, num_cells * num_actions> table{};
+    for (unsigned int row = 0; row < num_rows; ++row)
+        for (unsigned int col = 0; col < num_cols; ++col)
+        {
+            const unsigned int from = cell(row, col);
+            const bool wall[num_actions] = {
+                    col == num_cols - 1 || (row <= 1 && col == 0) || (row == 1 && col == 1),
+                    row == num_rows - 1,
+                    col == 0,
+                    row == 0
+            };
+            const unsigned int to[num_actions] = {from + 1, from + num_cols, from - 1, from - num_cols};
+            for (unsigned int action = 0; action < num_actions; ++action)
+                table[from * num_actions + action] = {
+                        static_cast<std::uint8_t>(wall[action] ? from : to[action]), wall[action]};
+        }
+    return table;
+}
+
+const std::array<GridWorldGameEnvironment::Transition, GridWorldGameEnvironment::num_cells *
+                 GridWorldGameEnvironment::num_actions> GridWorldGameEnvironment::transitions =
+        make_transitions();
+
+const std::uint32_t GridWorldGameEnvironment::monster_cells =
+        std::uint32_t{1} << cell(1, 2) | std::uint32_t{1} << cell(2, 4) |
+        std::uint32_t{1} << cell(3, 0) | std::uint32_t{1} << cell(3, 1) |
+        std::uint32_t{1} << cell(3, 3);
 
+const std::array<std::uint32_t, GridWorldGameEnvironment::num_prizes + 1> GridWorldGameEnvironment::prize_cells = {
+        std::uint32_t{1} << cell(1, 2), std::uint32_t{1} << cell(2, 4),
+        std::uint32_t{1} << cell(3, 0), std::uint32_t{1} << cell(3, 1), 0
+};
 
-    gen = std::mt19937(std::random_device{}());
-    rand_real = std::uniform_real_distribution<>(0, 1);
-    rand_position = std::uniform_int_distribution<>(0, num_rows-1);
-    rand_prize = std::uniform_int_distribution<>(0, num_prizes-1);
+const unsigned int GridWorldGameEnvironment::repair_cell = cell(0, 1);
 
-    prize_idx = num_prizes; // prize = 4 means no prize
-    damaged = false;
-    current_state = {};
+void GridWorldGameEnvironment::env_init(const EnvironmentInit params)
+{
+    if (params.use_seed)
+        gen = rng::make_engine(params.seed, params.run, rng::env_stream);
+    else
+        gen = rng::make_engine(std::random_device{}());
+
+    current_state = {0, num_prizes, false};
 }
 
 /* The first method called when the episode starts; called before the
@@ -32,9 +67,10 @@ Observation GridWorldGameEnvironment::env_start()
     // this game is continuous; termination criteria will be some number of steps
     num_steps = 1;
 
-    start_position = { rand_position(gen), rand_position(gen) };
-    prize_idx = num_prizes; // prize = 4 means no prize
-    current_state = {start_position.row, start_position.col, prize_idx, damaged};
+    const unsigned int row = rng::uniform_int(gen, num_rows);
+    const unsigned int col = rng::uniform_int(gen, num_cols);
+    current_state.cell = static_cast<std::uint8_t>(cell(row, col));
+    current_state.prize_idx = num_prizes;
 
     Observation observation = { 0, convert_to_linear_state(current_state), false };
     return observation;
@@ -42,92 +78,59 @@ Observation GridWorldGameEnvironment::env_start()
 
 Observation GridWorldGameEnvironment::env_step(const Action action0)
 {
-    auto row = current_state.row;
-    auto col = current_state.col;
-    float reward{0};
+    auto prize_idx = current_state.prize_idx;
+    auto damaged = current_state.damaged;
 
     Action action;
-    Action rand_action = static_cast<Action>(rand_real(gen) * 20);
+    Action rand_action = rng::uniform_int(gen, 20);
     if (rand_action < 4)
         action = rand_action;
     else
         action = action0;
 
-    if (action == 0)  // move right
-    {
-        if (col == num_cols - 1)  // hit right wall; penalize
-            reward = -1;
-        else if ((row <= 1 && col == 0) || (row == 1 && col == 1))
-            // hit internal wall
-            reward = -1;
-        else
-            col++;
-    }
-    else if (action == 1)  // move down
-    {
-        if (row == num_rows - 1)  // hit bottom wall; penalize
-            reward = -1;
-        else
-            row++;
-    }
-    else if (action == 2)  // move left
-    {
-        if (col == 0)  // hit left wall; penalize
-            reward = -1;
-        else
-            col--;
-    }
-    else if (action == 3)  // move up
-    {
-        if (row == 0)  // hit top wall; penalize
-            reward = -1;
-        else
-            row--;
-    }
-    else
-    {
+    if (action >= num_actions)
         throw std::out_of_range("invalid action");
-    }
+
+    const Transition move = transitions[current_state.cell * num_actions + action];
+    const unsigned int position = move.next_cell;
+    float reward = move.hit_wall ? -1 : 0;
 
     // Should there be a prize? Apply criteria
-    if (prize_idx == num_prizes && rand_real(gen) < prize_prob)
+    if (prize_idx == num_prizes && rng::bernoulli(gen, prize_prob))
     {
         // select a new prize location (e.g., one of the four corners)
-        prize_idx = rand_prize(gen);
+        prize_idx = rng::uniform_int(gen, num_prizes);
     }
 
     // Did the agent get the prize?
-    if (prize_idx < num_prizes)
+    if ((prize_cells[prize_idx] >> position) & 1)
     {
-        if ((row == prize_positions[prize_idx].row) &&
-            (col == prize_positions[prize_idx].col))
-        {
-            reward += 10;
-            prize_idx = num_prizes;  // prize disappears
-        }
+        reward += 10;
+        prize_idx = num_prizes;  // prize disappears
     }
 
-    // Did the monster get the agent?
-    for (const auto pos : monster_positions)
+    // Did the monster get the agent? Each monster is drawn for in turn, until
+    // the one in the agent's cell turns out to be present
+    const unsigned int num_monsters = __builtin_popcount(monster_cells);
+    const unsigned int agent_monster = ((monster_cells >> position) & 1) ?
+            __builtin_popcount(monster_cells & ((std::uint32_t{1} << position) - 1)) : num_monsters;
+    for (unsigned int monster = 0; monster < num_monsters; ++monster)
     {
-        if (rand_real(gen) < monster_prob)  // monster is present
+        if (rng::bernoulli(gen, monster_prob) && monster == agent_monster)
         {
-            if ((row == pos.row) && (col == pos.col))
-            {
-                if (damaged)
-                    reward += -10;
-                else
-                    damaged = true;
-                break;
-            }
+            if (damaged)
+                reward += -10;
+            else
+                damaged = true;
+            break;
         }
     }
 
     // Does the agent get repaired?
-    if ((row == repair_position.row) && (col == repair_position.col))
+    if (position == repair_cell)
         damaged = false;
 
-    current_state = { row, col, prize_idx, damaged };
+    current_state = { static_cast<std::uint8_t>(position), prize_idx, damaged };
 
     // this game is continuous; termination criteria will be some number of steps
     bool is_terminal = false;
@@ -157,7 +160,6 @@ std::string GridWorldGameEnvironment::env_message(const std::string& message)
  */
 State GridWorldGameEnvironment::convert_to_linear_state(const InternalState& current_state) const
 {
-    return ( (current_state.row * num_cols + current_state.col) * num_prizes \
-            + current_state.prize_idx) * 2 + current_state.damaged;
+    return (current_state.cell * num_prizes + current_state.prize_idx) * 2 + current_state.damaged;
 }
 
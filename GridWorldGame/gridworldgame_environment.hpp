@@ -1,7 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <random>
-#include <vector>
+#include "rng.hpp"
 #include "rl_environment.hpp"
 
 using namespace rl;
@@ -20,41 +22,49 @@ public:
     virtual std::string env_message(const std::string& message) override;
 
 private:
-    struct Position { unsigned int row; unsigned int col; };
-
     struct InternalState
     {
-        unsigned int row; unsigned int col;
-        unsigned int prize_idx;
+        std::uint8_t cell;
+        std::uint8_t prize_idx;
         bool damaged;
     };
 
-    const unsigned int num_rows{5};
-    const unsigned int num_cols{5};
+    struct Transition
+    {
+        std::uint8_t next_cell;
+        bool hit_wall;  // penalized; the agent stays in its cell
+    };
 
-    Position start_position{};
+    static constexpr unsigned int num_rows{5};
+    static constexpr unsigned int num_cols{5};
+    static constexpr unsigned int num_cells{num_rows * num_cols};
+    static constexpr unsigned int num_actions{4};  // right, down, left, up
 
-    const std::vector<Position> monster_positions = {
-            {1, 2}, {2, 4}, {3, 0}, {3, 1}, {3, 3}
-    };
+    static constexpr unsigned int cell(const unsigned int row, const unsigned int col)
+    {
+        return row * num_cols + col;
+    }
+
+    // Moves from every cell, indexed by cell * num_actions + action
+    static const std::array<Transition, num_cells * num_actions> transitions;
+    static constexpr std::array<Transition, num_cells * num_actions> make_transitions();
+
+    // Bit c is set when cell c holds a monster; monsters are drawn for in
+    // cell order
+    static const std::uint32_t monster_cells;
     const float monster_prob = 0.4;
 
-    const unsigned int num_prizes = 4;
-    const std::vector<Position> prize_positions = {
-            {1, 2}, {2, 4}, {3, 0}, {3, 1}, {3, 3}
-    };
-    unsigned int prize_idx = num_prizes; // prize = 4 means no prize
+    // The cell bit of each prize, and no bit for prize_idx = num_prizes,
+    // which means no prize
+    static constexpr unsigned int num_prizes = 4;
+    static const std::array<std::uint32_t, num_prizes + 1> prize_cells;
     const float prize_prob = 0.3;
 
-    const Position repair_position = {0, 1};
-    bool damaged = false;
+    static const unsigned int repair_cell;
 
-    InternalState current_state{};
+    InternalState current_state{0, num_prizes, false};
 
-    std::mt19937 gen;
-    std::uniform_int_distribution<> rand_position;
-    std::uniform_int_distribution<> rand_prize;
-    std::uniform_real_distribution<> rand_real;
+    rng::Engine gen;
 
     State convert_to_linear_state(const InternalState& current_state) const;
 };
@@ -0,0 +1,238 @@
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "rng.hpp"
+#include "gridworldgame_environment.hpp"
+
+using namespace rl;
+using namespace env;
+
+/* The grid world as it was stepped before the transition table: a branch per
+ * action with the wall checks written out, and positions compared one by
+ * one. Kept as the reference GridWorldGameEnvironment must match draw for
+ * draw.
+ */
+class ReferenceGridWorldGameEnvironment : public Environment
+{
+public:
+    virtual void env_init(const EnvironmentInit params) override
+    {
+        if (params.use_seed)
+            gen = rng::make_engine(params.seed, params.run, rng::env_stream);
+        else
+            gen = rng::make_engine(std::random_device{}());
+
+        prize_idx = num_prizes; // prize = 4 means no prize
+        damaged = false;
+        current_state = {};
+    }
+
+    virtual Observation env_start() override
+    {
+        num_steps = 1;
+
+        start_position = { rng::uniform_int(gen, num_rows), rng::uniform_int(gen, num_rows) };
+        prize_idx = num_prizes; // prize = 4 means no prize
+        current_state = {start_position.row, start_position.col, prize_idx, damaged};
+
+        Observation observation = { 0, convert_to_linear_state(current_state), false };
+        return observation;
+    }
+
+    virtual Observation env_step(const Action action0) override
+    {
+        auto row = current_state.row;
+        auto col = current_state.col;
+        float reward{0};
+
+        Action action;
+        Action rand_action = rng::uniform_int(gen, 20);
+        if (rand_action < 4)
+            action = rand_action;
+        else
+            action = action0;
+
+        if (action == 0)  // move right
+        {
+            if (col == num_cols - 1)  // hit right wall; penalize
+                reward = -1;
+            else if ((row <= 1 && col == 0) || (row == 1 && col == 1))
+                // hit internal wall
+                reward = -1;
+            else
+                col++;
+        }
+        else if (action == 1)  // move down
+        {
+            if (row == num_rows - 1)  // hit bottom wall; penalize
+                reward = -1;
+            else
+                row++;
+        }
+        else if (action == 2)  // move left
+        {
+            if (col == 0)  // hit left wall; penalize
+                reward = -1;
+            else
+                col--;
+        }
+        else if (action == 3)  // move up
+        {
+            if (row == 0)  // hit top wall; penalize
+                reward = -1;
+            else
+                row--;
+        }
+        else
+        {
+            throw std::out_of_range("invalid action");
+        }
+
+        // Should there be a prize? Apply criteria
+        if (prize_idx == num_prizes && rng::bernoulli(gen, prize_prob))
+        {
+            // select a new prize location (e.g., one of the four corners)
+            prize_idx = rng::uniform_int(gen, num_prizes);
+        }
+
+        // Did the agent get the prize?
+        if (prize_idx < num_prizes)
+        {
+            if ((row == prize_positions[prize_idx].row) &&
+                (col == prize_positions[prize_idx].col))
+            {
+                reward += 10;
+                prize_idx = num_prizes;  // prize disappears
+            }
+        }
+
+        // Did the monster get the agent?
+        for (const auto pos : monster_positions)
+        {
+            if (rng::bernoulli(gen, monster_prob))  // monster is present
+            {
+                if ((row == pos.row) && (col == pos.col))
+                {
+                    if (damaged)
+                        reward += -10;
+                    else
+                        damaged = true;
+                    break;
+                }
+            }
+        }
+
+        // Does the agent get repaired?
+        if ((row == repair_position.row) && (col == repair_position.col))
+            damaged = false;
+
+        current_state = { row, col, prize_idx, damaged };
+
+        bool is_terminal = false;
+        if (num_steps > 1000)
+             is_terminal = true;
+        else
+            num_steps++;
+
+        Observation observation = { reward, convert_to_linear_state(current_state), is_terminal };
+
+        return observation;
+    }
+
+    virtual void env_cleanup() override { }
+    virtual std::string env_message(const std::string&) override { return std::string(""); }
+
+private:
+    struct Position { unsigned int row; unsigned int col; };
+
+    struct InternalState
+    {
+        unsigned int row; unsigned int col;
+        unsigned int prize_idx;
+        bool damaged;
+    };
+
+    const unsigned int num_rows{5};
+    const unsigned int num_cols{5};
+
+    Position start_position{};
+
+    const std::vector<Position> monster_positions = {
+            {1, 2}, {2, 4}, {3, 0}, {3, 1}, {3, 3}
+    };
+    const float monster_prob = 0.4;
+
+    const unsigned int num_prizes = 4;
+    const std::vector<Position> prize_positions = {
+            {1, 2}, {2, 4}, {3, 0}, {3, 1}, {3, 3}
+    };
+    unsigned int prize_idx = num_prizes; // prize = 4 means no prize
+    const float prize_prob = 0.3;
+
+    const Position repair_position = {0, 1};
+    bool damaged = false;
+
+    InternalState current_state{};
+
+    rng::Engine gen;
+
+    State convert_to_linear_state(const InternalState& current_state) const
+    {
+        return ( (current_state.row * num_cols + current_state.col) * num_prizes \
+                + current_state.prize_idx) * 2 + current_state.damaged;
+    }
+};
+
+int main()
+{
+    std::printf("GridWorldGame Test\n");
+
+    // Seeded runs of both environments, driven by the same random actions
+    // across several episodes, must see the same states, rewards and
+    // terminations at every step
+    bool pass = true;
+    constexpr unsigned int num_runs = 20;
+    constexpr unsigned int num_episodes = 3;
+    unsigned long num_steps{0};
+    for (unsigned int run=0; run < num_runs && pass; ++run)
+    {
+        EnvironmentInit env_params{run % 4, true, run};
+        GridWorldGameEnvironment env;
+        ReferenceGridWorldGameEnvironment reference;
+        env.env_init(env_params);
+        reference.env_init(env_params);
+        rng::Engine action_gen = rng::make_engine(run, run, rng::agent_stream);
+
+        for (unsigned int episode=0; episode < num_episodes && pass; ++episode)
+        {
+            Observation obs = env.env_start();
+            Observation expected = reference.env_start();
+            while (pass)
+            {
+                if (obs.state != expected.state || obs.reward != expected.reward ||
+                        obs.termination != expected.termination)
+                {
+                    pass = false;
+                    std::printf("test failed!\nrun %u episode %u step %lu: state %u, reward %f, "
+                            "terminal %d, expected state %u, reward %f, terminal %d\n",
+                            run, episode, num_steps, obs.state, obs.reward, obs.termination,
+                            expected.state, expected.reward, expected.termination);
+                }
+                if (obs.termination)
+                    break;
+                Action action = rng::uniform_int(action_gen, 4);
+                obs = env.env_step(action);
+                expected = reference.env_step(action);
+                ++num_steps;
+            }
+        }
+    }
+    if (pass && num_steps != num_runs * num_episodes * 1001)
+    {
+        pass = false;
+        std::printf("test failed!\n%lu steps, expected %u\n", num_steps, num_runs * num_episodes * 1001);
+    }
+    std::printf("GridWorldGame Transition Table Test %s\n", pass ? "Passed" : "Failed");
+}
@@ -7,24 +7,14 @@ import sys
 # Third-party libraries
 import matplotlib.pyplot as plt
 
+# Local
+from result_file import read_results
 
-def openFile(filename):
-  try:
-    f = open(filename)
-  except IOError:
-    text = 'Couldn\'t open \"%s\" for reading\n' % filename
-    sys.stderr.write(text)
-    return None
-  except:
-    sys.stderr.write('unknown error\n')
-    return None
-
-  return f
 
 def main():
 
   if len(sys.argv) != 2:
-    print('usage: python plot.py <file>')
+    print('usage: python plot.py avg_returns.bin')
     exit(1)
         
   file = str(sys.argv[1])
@@ -36,23 +26,11 @@ def create_plot(filename):
 
     """
 
-    f = openFile(filename)
-    if not f:
-      return
-
-    lines = f.readlines()
-    f.close()
-
-    avg_returns = {"Expected Sarsa": [], "Q-Learning": []}
-    for line in lines:
-        cols = line.split(' ')
-        cols = cols[0:-1]
-        [val0, val1] = [float(x.strip()) for x in cols]
-        avg_returns["Expected Sarsa"].append(val0)
-        avg_returns["Q-Learning"].append(val1)
+    config, columns = read_results(filename)
+    avg_returns = columns["avg_returns"]
 
-    for algorithm in avg_returns.keys():
-        plt.plot(avg_returns[algorithm], label=algorithm)
+    for row in range(avg_returns.shape[0]):
+        plt.plot(avg_returns[row], label=config["agent_%d" % row])
 
     plt.xlabel("Episodes")
     plt.ylabel("Sum of\n rewards\n during\n episode", rotation=0, labelpad=25)
@@ -1,4 +1,5 @@
 
+#include <stdexcept>
 #include "q_learning_agent.hpp"
 
 using namespace rl;
@@ -19,12 +20,13 @@ void QLearningAgent::agent_init(const AgentInit& params)
     discount = params.discount;
     seed = params.seed;
 
+    if (num_actions > max_actions)
+        throw(std::out_of_range("QLearningAgent: too many actions"));
+
     prev_state = 0;
     prev_action = 0;
 
-    gen = std::mt19937(seed);
-    rand_real = std::uniform_real_distribution<>(0, 1);
-    rand_int = std::uniform_int_distribution<>(0, num_actions-1);
+    gen = rng::make_engine(seed, params.run, rng::agent_stream);
 
     // Create an array for action-value estimates and initialize it to zero.
     Float2D::extent_gen extents;
@@ -50,8 +52,8 @@ Action QLearningAgent::agent_start(const State state)
 
     // Choose action using epsilon greedy
     Action action{0};
-    if (rand_real(gen) < epsilon)
-        action = rand_int(gen);
+    if (rng::bernoulli(gen, epsilon))
+        action = rng::uniform_int(gen, num_actions);
     else
         std::tie(action, std::ignore) = argmax(current_q);
 
@@ -84,8 +86,8 @@ Action QLearningAgent::agent_step(const float reward, const State state)
     // Choose action using epsilon greedy
     Action action{0};
     float expected_return = 0.0;
-    if (rand_real(gen) < epsilon)
-        action = rand_int(gen);
+    if (rng::bernoulli(gen, epsilon))
+        action = rng::uniform_int(gen, num_actions);
     else
         std::tie(action, expected_return) = argmax(current_q);
 
@@ -0,0 +1,110 @@
+#include <fstream>
+#include <stdexcept>
+#include "result_file.hpp"
+
+namespace rl {
+
+namespace {
+
+std::string json_string(const std::string& s)
+{
+    std::string quoted = "\"";
+    for (const char c : s)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+            quoted += ' ';
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::size_t aligned(const std::size_t n)
+{
+    return (n + ResultFile::alignment - 1) / ResultFile::alignment * ResultFile::alignment;
+}
+
+} // namespace
+
+void ResultFile::set_config(const std::string& name, const std::string& value)
+{
+    for (auto& entry : config)
+        if (entry.first == name)
+        {
+            entry.second = value;
+            return;
+        }
+    config.emplace_back(name, value);
+}
+
+void ResultFile::add_column(const std::string& name, const std::vector<std::size_t>& shape, const float* data)
+{
+    add_column(name, "<f4", shape, data, sizeof(float));
+}
+
+void ResultFile::add_column(const std::string& name, const std::vector<std::size_t>& shape, const double* data)
+{
+    add_column(name, "<f8", shape, data, sizeof(double));
+}
+
+void ResultFile::add_column(const std::string& name, const std::vector<std::size_t>& shape, const std::uint32_t* data)
+{
+    add_column(name, "<u4", shape, data, sizeof(std::uint32_t));
+}
+
+void ResultFile::add_column(const std::string& name, const std::string& dtype, const std::vector<std::size_t>& shape,
+                            const void* data, const std::size_t item_size)
+{
+    std::size_t num_bytes = item_size;
+    for (const std::size_t n : shape)
+        num_bytes *= n;
+    columns.push_back({name, dtype, shape, static_cast<const char*>(data), num_bytes});
+}
+
+void ResultFile::write(const std::string& path) const
+{
+    std::string header = "{\"config\": {";
+    for (std::size_t i = 0; i < config.size(); ++i)
+        header += (i ? ", " : "") + json_string(config[i].first) + ": " + json_string(config[i].second);
+    header += "}, \"columns\": [";
+
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < columns.size(); ++i)
+    {
+        const Column& column = columns[i];
+        header += std::string(i ? ", " : "") + "{\"name\": " + json_string(column.name) +
+                  ", \"dtype\": \"" + column.dtype + "\", \"shape\": [";
+        for (std::size_t d = 0; d < column.shape.size(); ++d)
+            header += (d ? ", " : "") + std::to_string(column.shape[d]);
+        header += "], \"offset\": " + std::to_string(offset) + "}";
+        offset = aligned(offset + column.num_bytes);
+    }
+    header += "]}\n";
+
+    constexpr char magic[8] = {'R', 'L', 'R', 'E', 'S', 'U', 'L', 'T'};
+    constexpr std::uint32_t version = 1;
+    constexpr std::size_t prefix_size = sizeof(magic) + 2 * sizeof(std::uint32_t);
+    header.resize(aligned(prefix_size + header.size()) - prefix_size, ' ');
+    const std::uint32_t header_size = static_cast<std::uint32_t>(header.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(magic, sizeof(magic));
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+    file.write(header.data(), header.size());
+
+    // One write per column, then the padding up to the next one
+    static const char padding[alignment] = {};
+    for (const Column& column : columns)
+    {
+        file.write(column.data, column.num_bytes);
+        file.write(padding, aligned(column.num_bytes) - column.num_bytes);
+    }
+    file.close();
+    if (!file)
+        throw std::runtime_error("cannot write results to " + path);
+}
+
+} // rl
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rl {
+
+/* The results of an experiment as one binary file: a JSON header with the
+ * config of the experiment and the name, dtype and shape of each column,
+ * then every column as one contiguous block, stored as it is in memory
+ * (little endian, row major). numpy maps the blocks without reading them,
+ * see result_file.py.
+ *
+ *     bytes 0-7     "RLRESULT"
+ *     bytes 8-11    format version, 1
+ *     bytes 12-15   header length
+ *     bytes 16-     JSON header, padded with spaces to end on a multiple
+ *                   of 64 bytes
+ *     then          the columns, each at the offset the header gives from
+ *                   the end of the header, a multiple of 64 bytes
+ */
+class ResultFile {
+public:
+    void set_config(const std::string& name, const std::string& value);
+
+    // The data of a column is written from where it is, so it must stay
+    // valid until write()
+    void add_column(const std::string& name, const std::vector<std::size_t>& shape, const float* data);
+    void add_column(const std::string& name, const std::vector<std::size_t>& shape, const double* data);
+    void add_column(const std::string& name, const std::vector<std::size_t>& shape, const std::uint32_t* data);
+
+    // Throws std::runtime_error if the file cannot be written
+    void write(const std::string& path) const;
+
+    static constexpr std::size_t alignment = 64;
+
+private:
+    struct Column
+    {
+        std::string name;
+        std::string dtype;  // numpy's name for the type
+        std::vector<std::size_t> shape;
+        const char* data;
+        std::size_t num_bytes;
+    };
+
+    std::vector<std::pair<std::string, std::string>> config;
+    std::vector<Column> columns;
+
+    void add_column(const std::string& name, const std::string& dtype, const std::vector<std::size_t>& shape,
+                    const void* data, const std::size_t item_size);
+};
+
+} // rl
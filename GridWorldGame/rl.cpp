@@ -1,5 +1,6 @@
 #include <memory>
 #include <string>
+#include <tuple>
 #include "rl.hpp"
 
 namespace rl {
@@ -7,99 +8,55 @@ namespace rl {
 using namespace env;
 using namespace agent;
 
+// RL runs StaticRL over the virtual Environment and Agent interfaces
+
 void RL::rl_init(const EnvironmentInit env_params, const AgentInit agent_params)
 {
-    env->env_init(env_params);
-    agent->agent_init(agent_params);
-
-    total_reward = 0.0;
-    last_action = 0;
-    num_steps = 0;
-    num_episodes = 0;
+    loop.rl_init(env_params, agent_params);
 }
 
 std::pair<State, Action> RL::rl_start()
 {
-    total_reward = 0.0;
-    num_steps = 1;
-
-    Observation obs = env->env_start();
-    State last_state = obs.state;
-    last_action = agent->agent_start(last_state);
-
-    return std::make_pair(last_state, last_action);
+    return loop.rl_start();
 }
 
 Action RL::rl_agent_start(const State state)
 {
-    return agent->agent_start(state);
+    return loop.rl_agent_start(state);
 }
 
 Action RL::rl_agent_step(const float reward, const State state)
 {
-    return agent->agent_step(reward, state);
+    return loop.rl_agent_step(reward, state);
 }
 
 void RL::rl_agent_end(const float reward)
 {
-    agent->agent_end(reward);
+    loop.rl_agent_end(reward);
 }
 
-/* Starts the environment.
- * Returns:
- *     observation - the initial reward, state, and termination
- */
 Observation RL::rl_env_start()
 {
-    total_reward = 0;
-    num_steps = 1;
-
-    return env->env_start();
+    return loop.rl_env_start();
 }
 
 Observation RL::rl_env_step(const Action action)
 {
-    auto observation = env->env_step(action);
-    total_reward += observation.reward;
-
-    if (observation.termination)
-        num_episodes++;
-    else
-        num_steps++;
-
-    return observation;
+    return loop.rl_env_step(action);
 }
 
 std::tuple<Observation, Action> RL::rl_step()
 {
-    auto obs = env->env_step(last_action);
-    total_reward += obs.reward;
-
-    if (obs.termination)
-    {
-        num_episodes++;
-        agent->agent_end(obs.reward);
-    }
-    else
-    {
-        num_steps++;
-        last_action = agent->agent_step(obs.reward, obs.state);
-    }
-
-    return std::make_tuple(obs, last_action);
+    return loop.rl_step();
 }
 
 void RL::rl_cleanup()
 {
-    env->env_cleanup();
-    agent->agent_cleanup();
+    loop.rl_cleanup();
 }
 
-/* Run an episode
- *     Inputs:
- *         max_steps - the maximum number of steps in an episode
- *     Returns:
- *         is_terminal - if the episode should or has terminated
+/* Runs an episode as StaticRL::rl_episode does, but through the virtual
+ * rl_start and rl_step, so a subclass that overrides them runs its own
  */
 bool RL::rl_episode(unsigned int max_steps)
 {
@@ -107,7 +64,7 @@ bool RL::rl_episode(unsigned int max_steps)
     bool is_terminal = false;
     rl_start();
 
-    while (!is_terminal && ((max_steps == 0) || (num_steps < max_steps)))
+    while (!is_terminal && ((max_steps == 0) || (loop.rl_num_steps() < max_steps)))
     {
         std::tie(obs, std::ignore) = rl_step();
         is_terminal = obs.termination;
@@ -115,8 +72,4 @@ bool RL::rl_episode(unsigned int max_steps)
     return true;
 }
 
-
-
-
 } // rl
-
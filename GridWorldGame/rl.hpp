@@ -4,6 +4,7 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
 #include "rl_types.hpp"
 #include "rl_environment.hpp"
 #include "rl_agent.hpp"
@@ -13,41 +14,184 @@ namespace rl {
 using namespace env;
 using namespace agent;
 
+/* The RL loop for an environment and an agent of known types. Both are held
+ * as members, so every call binds statically and can be inlined, e.g.
+ *
+ *     StaticRL<MyEnvironment, MyAgent> rl;
+ *
+ * With reference types the loop runs whatever objects it is given, through
+ * their virtual methods; RL below is that loop over Environment and Agent.
+ * RL's own members stay virtual, and its rl_episode calls rl_start and
+ * rl_step through them, so a subclass may override any of them.
+ */
+template <class Env, class AgentType>
+class StaticRL {
+public:
+    StaticRL() = default;
+    StaticRL(Env env, AgentType agent)
+    : env(std::forward<Env>(env)), agent(std::forward<AgentType>(agent)) { }
+
+    void rl_init(const EnvironmentInit env_init, const AgentInit agent_init);
+    std::pair<State, Action> rl_start();
+    std::tuple<Observation, Action> rl_step();
+    void rl_cleanup();
+    bool rl_episode(unsigned int max_steps);
+    float rl_return() const { return total_reward; }
+    unsigned int rl_num_steps() const { return num_steps; }
+    unsigned int rl_num_episodes() const { return num_episodes; }
+
+    Observation rl_env_start();
+    Observation rl_env_step(const Action action);
+    std::string rl_env_message(const std::string& message) { return env.env_message(message); }
+    Action rl_agent_start(const State state) { return agent.agent_start(state); }
+    Action rl_agent_step(const float reward, const State state) { return agent.agent_step(reward, state); }
+    void rl_agent_end(const float reward) { agent.agent_end(reward); }
+    std::string rl_agent_message(const std::string& message) { return agent.agent_message(message); }
+
+    Env& get_env() { return env; }
+    AgentType& get_agent() { return agent; }
+
+private:
+    Env env;
+    AgentType agent;
+    float total_reward{0.0};
+    Action last_action{};
+    unsigned int num_steps{0};
+    unsigned int num_episodes{0};
+
+};
+
 class RL {
 public:
     RL(std::shared_ptr<Environment> env, std::shared_ptr<Agent> agent)
-    : env(env), agent(agent) { };
-    virtual ~RL() = default;
+    : env(env), agent(agent), loop(*env, *agent) { }
+    virtual ~RL() { }
 
     virtual void rl_init(const EnvironmentInit env_init, const AgentInit agent_init);
     virtual std::pair<State, Action> rl_start();
     virtual std::tuple<Observation, Action> rl_step();
     virtual void rl_cleanup();
     virtual bool rl_episode(unsigned int max_steps);
-    virtual float rl_return() const { return total_reward; }
-    virtual unsigned int rl_num_steps() const { return num_steps; }
-    virtual unsigned int rl_num_episodes() const { return num_episodes; }
+    virtual float rl_return() const { return loop.rl_return(); }
+    virtual unsigned int rl_num_steps() const { return loop.rl_num_steps(); }
+    virtual unsigned int rl_num_episodes() const { return loop.rl_num_episodes(); }
 
 protected:
     virtual Observation rl_env_start();
     virtual Observation rl_env_step(const Action action);
     virtual std::string rl_env_message(const std::string& message)
-            { return env->env_message(message); }
+            { return loop.rl_env_message(message); }
     virtual Action rl_agent_start(const State state);
     virtual Action rl_agent_step(const float reward, const State state);
     virtual void rl_agent_end(const float reward);
     virtual std::string rl_agent_message(const std::string& message)
-            { return agent->agent_message(message); }
-
+            { return loop.rl_agent_message(message); }
 
 private:
     std::shared_ptr<Environment> env;
     std::shared_ptr<Agent> agent;
-    float total_reward{0.0};
-    Action last_action{};
-    unsigned int num_steps{0};
-    unsigned int num_episodes{0};
+    StaticRL<Environment&, Agent&> loop;
 
 };
 
+template <class Env, class AgentType>
+void StaticRL<Env, AgentType>::rl_init(const EnvironmentInit env_params, const AgentInit agent_params)
+{
+    env.env_init(env_params);
+    agent.agent_init(agent_params);
+
+    total_reward = 0.0;
+    last_action = 0;
+    num_steps = 0;
+    num_episodes = 0;
+}
+
+template <class Env, class AgentType>
+std::pair<State, Action> StaticRL<Env, AgentType>::rl_start()
+{
+    total_reward = 0.0;
+    num_steps = 1;
+
+    Observation obs = env.env_start();
+    State last_state = obs.state;
+    last_action = agent.agent_start(last_state);
+
+    return std::make_pair(last_state, last_action);
+}
+
+/* Starts the environment.
+ * Returns:
+ *     observation - the initial reward, state, and termination
+ */
+template <class Env, class AgentType>
+Observation StaticRL<Env, AgentType>::rl_env_start()
+{
+    total_reward = 0;
+    num_steps = 1;
+
+    return env.env_start();
+}
+
+template <class Env, class AgentType>
+Observation StaticRL<Env, AgentType>::rl_env_step(const Action action)
+{
+    auto observation = env.env_step(action);
+    total_reward += observation.reward;
+
+    if (observation.termination)
+        num_episodes++;
+    else
+        num_steps++;
+
+    return observation;
+}
+
+template <class Env, class AgentType>
+std::tuple<Observation, Action> StaticRL<Env, AgentType>::rl_step()
+{
+    auto obs = env.env_step(last_action);
+    total_reward += obs.reward;
+
+    if (obs.termination)
+    {
+        num_episodes++;
+        agent.agent_end(obs.reward);
+    }
+    else
+    {
+        num_steps++;
+        last_action = agent.agent_step(obs.reward, obs.state);
+    }
+
+    return std::make_tuple(obs, last_action);
+}
+
+template <class Env, class AgentType>
+void StaticRL<Env, AgentType>::rl_cleanup()
+{
+    env.env_cleanup();
+    agent.agent_cleanup();
+}
+
+/* Run an episode
+ *     Inputs:
+ *         max_steps - the maximum number of steps in an episode
+ *     Returns:
+ *         is_terminal - if the episode should or has terminated
+ */
+template <class Env, class AgentType>
+bool StaticRL<Env, AgentType>::rl_episode(unsigned int max_steps)
+{
+    Observation obs;
+    bool is_terminal = false;
+    rl_start();
+
+    while (!is_terminal && ((max_steps == 0) || (num_steps < max_steps)))
+    {
+        std::tie(obs, std::ignore) = rl_step();
+        is_terminal = obs.termination;
+    }
+    return true;
+}
+
 } // rl
@@ -1,14 +1,116 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <random>
 #include <string>
 #include <utility>
+#include <vector>
 #include "boost/multi_array.hpp"
 #include "rl_types.hpp"
+#include "rng.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace rl {
 namespace agent {
 
+// Greedy selection over at most 32 action values without touching the heap.
+// ties_mask() returns the largest of q[0, n) and sets bit i of mask for every
+// q[i] equal to it. q must be readable for 32 values, whatever n. NaN values
+// are skipped, so they never win or tie; when every value is NaN the mask is
+// empty and -inf is returned. The AVX2 versions follow the same rule.
+template <class F>
+inline F ties_mask(const F* q, unsigned int n, uint32_t& mask)
+{
+    F top = -HUGE_VAL;
+    for (unsigned int i = 0; i < n; ++i)
+        if (q[i] > top)
+            top = q[i];
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; ++i)
+        if (q[i] == top)
+            mask |= uint32_t{1} << i;
+    return top;
+}
+
+#ifdef __AVX2__
+/* Lanes at or past n, and NaN lanes, are filled with -inf so they never win
+ * or tie */
+inline float ties_mask(const float* q, unsigned int n, uint32_t& mask)
+{
+    const __m256 lowest = _mm256_set1_ps(-HUGE_VALF);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 top = lowest;
+    for (unsigned int i = 0; i < n; i += 8)
+    {
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), lanes);
+        __m256 v = _mm256_loadu_ps(q + i);
+        __m256 keep = _mm256_and_ps(_mm256_castsi256_ps(valid), _mm256_cmp_ps(v, v, _CMP_ORD_Q));
+        v = _mm256_blendv_ps(lowest, v, keep);
+        top = _mm256_max_ps(top, v);
+    }
+    top = _mm256_max_ps(top, _mm256_permute2f128_ps(top, top, 1));
+    top = _mm256_max_ps(top, _mm256_shuffle_ps(top, top, _MM_SHUFFLE(1, 0, 3, 2)));
+    top = _mm256_max_ps(top, _mm256_shuffle_ps(top, top, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; i += 8)
+    {
+        __m256 eq = _mm256_cmp_ps(_mm256_loadu_ps(q + i), top, _CMP_EQ_OQ);
+        mask |= static_cast<uint32_t>(_mm256_movemask_ps(eq)) << i;
+    }
+    if (n < 32)
+        mask &= (uint32_t{1} << n) - 1;
+    return _mm256_cvtss_f32(top);
+}
+
+inline double ties_mask(const double* q, unsigned int n, uint32_t& mask)
+{
+    const __m256d lowest = _mm256_set1_pd(-HUGE_VAL);
+    const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+
+    __m256d top = lowest;
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+        __m256i valid = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i), lanes);
+        __m256d v = _mm256_loadu_pd(q + i);
+        __m256d keep = _mm256_and_pd(_mm256_castsi256_pd(valid), _mm256_cmp_pd(v, v, _CMP_ORD_Q));
+        v = _mm256_blendv_pd(lowest, v, keep);
+        top = _mm256_max_pd(top, v);
+    }
+    top = _mm256_max_pd(top, _mm256_permute2f128_pd(top, top, 1));
+    top = _mm256_max_pd(top, _mm256_shuffle_pd(top, top, 0x5));
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+        __m256d eq = _mm256_cmp_pd(_mm256_loadu_pd(q + i), top, _CMP_EQ_OQ);
+        mask |= static_cast<uint32_t>(_mm256_movemask_pd(eq)) << i;
+    }
+    if (n < 32)
+        mask &= (uint32_t{1} << n) - 1;
+    return _mm256_cvtsd_f64(top);
+}
+#endif
+
+/* Position of the k-th lowest set bit of mask, counting from 0; mask must
+ * have more than k bits set */
+inline unsigned int select_bit(uint32_t mask, unsigned int k)
+{
+#ifdef __BMI2__
+    return __builtin_ctz(_pdep_u32(uint32_t{1} << k, mask));
+#else
+    for (; k > 0; --k)
+        mask &= mask - 1;
+    return __builtin_ctz(mask);
+#endif
+}
+
 struct AgentInit {
     unsigned int num_actions{0};
     unsigned int num_states{0};
@@ -16,6 +118,7 @@ struct AgentInit {
     float step_size{0.1}; // alpha
     float discount{1.0};  // the discount factor
     unsigned int seed{0};
+    unsigned int run{0};  // each run of an experiment draws its own stream
 };
 
 class Agent {
@@ -30,6 +133,9 @@ public:
     virtual void agent_cleanup() = 0;
     virtual std::string agent_message(const std::string& message) = 0;
 
+    // Upper bound on num_actions; action values live in fixed size scratch
+    static constexpr unsigned int max_actions = 32;
+
 protected:
     unsigned int num_actions{0};
     unsigned int num_states{0};
@@ -37,9 +143,7 @@ protected:
     float step_size{0.1}; // alpha
     float discount{1.0};  // the discount factor
     unsigned int seed{0};
-    std::mt19937 gen; //Standard mersenne_twister_engine
-    std::uniform_real_distribution<> rand_real;
-    std::uniform_int_distribution<> rand_int;
+    rng::Engine gen;  // picked with RNG_ENGINE, std::mt19937 by default
 
     State prev_state{0};
     Action prev_action{0};
@@ -48,60 +152,42 @@ protected:
     Float2D q_values;
     Float2D weights;
 
+    /* picks one of the actions set in ties uniformly, drawing from gen just
+     * as indexing a list of the tied actions would. No ties means every
+     * action value was NaN, e.g. once the weights diverged; any action is
+     * then as good as another, so all of them tie */
+    Action break_ties(uint32_t ties)
+    {
+        if (ties == 0)
+            ties = num_actions < 32 ? (uint32_t{1} << num_actions) - 1 : ~uint32_t{0};
+        return select_bit(ties, rng::uniform_int(gen, __builtin_popcount(ties)));
+    }
+
     /* argmax but with random tie-breaking */
     std::pair<Action, float> argmax(Float2D::array_view<1>::type q_view)
     {
-        float top = -HUGE_VALF;
-        std::vector<unsigned int> ties;
-
-        using index = Float2D::index;
-        for(index i = 0; i < num_actions; ++i)
-        {
-            if (q_view[i] > top)
-            {
-                top = q_view[i];
-                ties.clear();
-            }
-            if (q_view[i] == top)
-                ties.push_back(i);
-        }
+        std::array<float, max_actions> q{};
+        for (unsigned int i = 0; i < num_actions; ++i)
+            q[i] = q_view[i];
 
-        std::uniform_int_distribution<> sample(0, ties.size()-1);
-        Action winning_idx = ties[sample(gen)];
-        float winning_val = q_view[winning_idx];
-
-        return std::make_pair(winning_idx, winning_val);
+        uint32_t ties;
+        float top = ties_mask(q.data(), num_actions, ties);
+        return std::make_pair(break_ties(ties), top);
     }
 
     /* selects an action using epsilon greedy with random tie-breaking */
     std::pair<Action, float> select_action(const std::vector<uint32_t>& tiles)
     {
-        std::vector<float> q_values(num_actions, 0);
+        std::array<float, max_actions> q_values{};
         for(Action i = 0; i < num_actions; ++i)
         {
             for (std::size_t j=0; j < tiles.size(); ++j)
                 q_values[i] += weights[i][tiles[j]];
         }
 
-        float top = -HUGE_VALF;
-        std::vector<unsigned int> ties;
-
-        for(unsigned i = 0; i < num_actions; ++i)
-        {
-            if (q_values[i] > top)
-            {
-                top = q_values[i];
-                ties.clear();
-            }
-            if (q_values[i] == top)
-                ties.push_back(i);
-        }
-
-        std::uniform_int_distribution<> sample(0, ties.size()-1);
-        Action winning_idx = ties[sample(gen)];
-        float winning_val = q_values[winning_idx];
-
-        return std::make_pair(winning_idx, winning_val);
+        uint32_t ties;
+        float top = ties_mask(q_values.data(), num_actions, ties);
+        return std::make_pair(break_ties(ties), top);
     }
 
 };
@@ -1,15 +1,19 @@
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdio>
-#include <fstream>
 #include <map>
 #include <memory>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <string>
 #include <vector>
 
 #include "rl.hpp"
+#include "result_file.hpp"
+#include "sweep.hpp"
 #include "mountain_car_environment.hpp"
 #include "sarsa_agent.hpp"
 
@@ -17,73 +21,110 @@ using namespace rl;
 using namespace env;
 using namespace agent;
 
-
-int main()
+/* Runs the study of a sweep config, by default mountain_car_sweep.cfg:
+ *
+ *     MountainCar [config [worker | merge queue_dir]]
+ *
+ * Each cell records the steps of every episode, and avg_steps.bin gets the
+ * average over the runs, a row per config and a column per episode. As a
+ * worker it runs the cells no other worker on queue_dir has claimed; merge
+ * collects the cells of the workers and writes avg_steps.bin.
+ */
+int main(int argc, char* argv[])
 {
-    constexpr unsigned int num_runs = 20;
-    constexpr unsigned int num_episodes = 100;
-
-    std::shared_ptr<Agent> agent = std::make_shared<SarsaAgent>();
-    std::shared_ptr<Environment> env = std::make_shared<MountainCarEnvironment>();
-
-    constexpr float step_size = 0.5;
-    AgentInit agent_params{3, 0, 0.1, step_size, 1.0, 0, 8, 8, 4096};
-    EnvironmentInit env_params;
-
-    // a list of pairs of (num_tilings, num_tiles)
-    const std::vector<std::pair<unsigned int, unsigned int>> agent_options = { {2, 16}, {32, 4}, {8, 8} };
-    const unsigned int num_opts = 3;
-
-    std::array<std::array<std::array<unsigned int, num_runs>, num_opts>, num_episodes> all_steps;
-    std::array<std::array<float, num_opts>, num_episodes> avg_steps;
-
-    for (unsigned int opt=0; opt < num_opts; ++opt)
+    const std::string mode = argc == 4 ? argv[2] : "";
+    if (argc > 4 || argc == 3 || (argc == 4 && mode != "worker" && mode != "merge"))
     {
-        auto tic = std::chrono::steady_clock::now();
+        std::fprintf(stderr, "usage: %s [config [worker | merge queue_dir]]\n", argv[0]);
+        return 1;
+    }
 
-        unsigned int num_tilings{0};
-        unsigned int num_tiles{0};
-        std::tie(num_tilings, num_tiles) = agent_options[opt];
-        agent_params.num_tilings = num_tilings;
-        agent_params.num_tiles = num_tiles;
-        agent_params.step_size = step_size / num_tilings;
+    // Defaults for the fields the config leaves out; run r of a config draws
+    // stream r of the seeds, wherever it runs
+    AgentInit agent_params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+    EnvironmentInit env_params = {0, true};
 
-        for (unsigned int run=0; run < num_runs; ++run)
+    // A config without a step size gets 0.5 / num_tilings for its own tilings
+    auto agent_defaults = [](AgentInit& params, const Sweep::Config& config)
+    {
+        if (Sweep::get_value(config, "step_size", "").empty())
+            params.step_size = 0.5 / params.num_tilings;
+    };
+    // The only setting run_cell reads; any other name must be an AgentInit field
+    const std::vector<std::string> settings = {"num_episodes"};
+    Sweep sweep(argc > 1 ? argv[1] : MOUNTAIN_CAR_SWEEP_FILE, env_params, agent_params, settings, agent_defaults);
+    const unsigned int num_runs = sweep.get_num_runs();
+
+    auto make_env = []() { return std::make_shared<MountainCarEnvironment>(); };
+    auto make_agent = []() { return std::make_shared<SarsaAgent>(); };
+    auto run_cell = [](RL& rl, const Sweep::Config& config, const unsigned int)
+    {
+        const unsigned int num_episodes = std::stoul(Sweep::get_value(config, "num_episodes", "100"));
+        std::vector<double> steps(num_episodes);
+        for (unsigned int episode=0; episode < num_episodes; ++episode)
         {
-            agent_params.seed = run;
-            RL rl(env, agent);
-            rl.rl_init(env_params, agent_params);
-
-            for (unsigned int episode=0; episode < num_episodes; ++episode)
-            {
-                rl.rl_episode(15000);
-                all_steps[episode][opt][run] = rl.rl_num_steps();
-            }
+            rl.rl_episode(15000);
+            steps[episode] = rl.rl_num_steps();
         }
+        return steps;
+    };
 
-        for (unsigned int episode=0; episode < num_episodes; ++episode)
+    auto tic = std::chrono::steady_clock::now();
+    if (mode == "worker")
+    {
+        std::size_t num_cells = sweep.run_worker(argv[3], make_env, make_agent, run_cell);
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+        std::printf("%zu cells run, (elapsed %f s)\n", num_cells, diff.count());
+        return 0;
+    }
+    else if (mode == "merge")
+    {
+        std::size_t num_missing = sweep.merge(argv[3]);
+        if (num_missing != 0)
         {
-            float sum = std::accumulate(all_steps[episode][opt].cbegin(), all_steps[episode][opt].cend(), 0);
-            avg_steps[episode][opt] = sum / num_runs;
+            std::fprintf(stderr, "%zu cells are not done yet\n", num_missing);
+            return 1;
         }
-
-        auto toc = std::chrono::steady_clock::now();
-        std::chrono::duration<double> diff = toc - tic;
-        std::printf("step_size: %4.3f, num_tilings: %d, num_tiles: %d, %5.2f it/s, %4.3f s/it, (elapsed %f s)\n",
-                agent_params.step_size, agent_params.num_tilings, agent_params.num_tiles,
-                num_runs/diff.count(), diff.count()/num_runs, diff.count());
+    }
+    else
+    {
+        std::size_t num_cells = sweep.run(make_env, make_agent, run_cell);
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+        std::printf("%zu cells run, %zu read from %s, %5.2f it/s, (elapsed %f s)\n",
+                num_cells, sweep.get_num_configs() * num_runs - num_cells, sweep.get_results_path().c_str(),
+                num_cells/diff.count(), diff.count());
     }
 
-    std::ofstream fout;
-    fout.open ("avg_steps.txt");
-
-    for (unsigned int episode=0; episode < num_episodes; ++episode)
+    std::vector<std::vector<float>> avg_steps(sweep.get_num_configs());
+    std::size_t num_episodes = 0;
+    for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
     {
-        for (unsigned int opt=0; opt < num_opts; ++opt)
-            fout << avg_steps[episode][opt] << " ";
-        fout << std::endl;
+        avg_steps[config].resize(sweep.get_result(config, 0).size());
+        for (unsigned int run=0; run < num_runs; ++run)
+            for (std::size_t episode=0; episode < avg_steps[config].size(); ++episode)
+                avg_steps[config][episode] += sweep.get_result(config, run).at(episode) / num_runs;
+        num_episodes = std::max(num_episodes, avg_steps[config].size());
+
+        for (const auto& param : sweep.get_config(config))
+            std::printf("%s: %s, ", param.first.c_str(), param.second.c_str());
+        std::printf("average steps %.1f\n", std::accumulate(avg_steps[config].cbegin(),
+                avg_steps[config].cend(), 0.0) / avg_steps[config].size());
     }
-    fout.close();
 
+    // avg_steps.bin: a row of average steps per config, padded with NaN past
+    // the episodes of shorter configs, the configs in the header, see
+    // result_file.hpp
+    std::vector<float> steps_table(avg_steps.size() * num_episodes, std::numeric_limits<float>::quiet_NaN());
+    ResultFile results;
+    results.set_config("num_runs", std::to_string(num_runs));
+    for (std::size_t config=0; config < avg_steps.size(); ++config)
+    {
+        std::copy(avg_steps[config].cbegin(), avg_steps[config].cend(), steps_table.begin() + config * num_episodes);
+        std::string params;
+        for (const auto& param : sweep.get_config(config))
+            params += (params.empty() ? "" : ", ") + param.first + ": " + param.second;
+        results.set_config("config_" + std::to_string(config), params);
+    }
+    results.add_column("avg_steps", {avg_steps.size(), num_episodes}, steps_table.data());
+    results.write("avg_steps.bin");
 }
-
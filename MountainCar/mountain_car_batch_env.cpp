@@ -0,0 +1,99 @@
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "mountain_car_batch_env.hpp"
+
+using namespace rl;
+using namespace env;
+
+/* The dynamics of MountainCarEnvironment, in float for every car:
+ *     v_t+1 = bound(v_t + 0.001 * A_t - 0.0025 * cos(3x_t))
+ *     x_t+1 = bound(x_t + v_t+1)
+ * with v_t+1 reset to zero at the left bound and the episode ending at the
+ * right bound.
+ */
+void MountainCarBatchEnv::env_init(const EnvironmentInit params, const std::size_t num_cars)
+{
+    const unsigned int seed = params.use_seed ? params.seed : std::random_device{}();
+    gens.clear();
+    for (std::size_t car = 0; car < num_cars; ++car)
+        gens.push_back(rng::make_engine(seed, params.run + car, rng::env_stream));
+
+    positions.assign(num_cars, 0);
+    velocities.assign(num_cars, 0);
+    rewards.assign(num_cars, 0);
+    terminal_mask.assign((num_cars + 31) / 32, 0);
+}
+
+void MountainCarBatchEnv::env_start()
+{
+    for (std::size_t car = 0; car < size(); ++car)
+        start_car(car);
+    std::fill(rewards.begin(), rewards.end(), 0.0f);
+    std::fill(terminal_mask.begin(), terminal_mask.end(), 0);
+}
+
+void MountainCarBatchEnv::start_car(const std::size_t car)
+{
+    positions[car] = static_cast<float>(rng::uniform(gens[car], -0.6, -0.4));
+    velocities[car] = 0;
+}
+
+void MountainCarBatchEnv::env_step(const Action* actions)
+{
+    std::fill(terminal_mask.begin(), terminal_mask.end(), 0);
+
+    std::size_t i = 0;
+#ifdef __AVX2__
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 min_velocity = _mm256_set1_ps(-0.07f), max_velocity = _mm256_set1_ps(0.07f);
+    const __m256 min_position = _mm256_set1_ps(-1.2f), max_position = _mm256_set1_ps(0.5f);
+    for (; i + 8 <= size(); i += 8)
+    {
+        __m256 a = _mm256_sub_ps(_mm256_cvtepi32_ps(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(actions + i))), one);
+        __m256 x = _mm256_loadu_ps(positions.data() + i);
+        __m256 v = _mm256_loadu_ps(velocities.data() + i);
+
+        __m256 gravity = _mm256_mul_ps(_mm256_set1_ps(0.0025f),
+                                       cos_approx(_mm256_mul_ps(_mm256_set1_ps(3.0f), x)));
+        v = _mm256_sub_ps(_mm256_add_ps(v, _mm256_mul_ps(_mm256_set1_ps(0.001f), a)), gravity);
+        v = _mm256_min_ps(_mm256_max_ps(v, min_velocity), max_velocity);
+        x = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(x, v), min_position), max_position);
+
+        v = _mm256_blendv_ps(v, zero, _mm256_cmp_ps(x, min_position, _CMP_EQ_OQ));
+        __m256 done = _mm256_cmp_ps(x, max_position, _CMP_EQ_OQ);
+
+        _mm256_storeu_ps(positions.data() + i, x);
+        _mm256_storeu_ps(velocities.data() + i, v);
+        _mm256_storeu_ps(rewards.data() + i, _mm256_blendv_ps(_mm256_set1_ps(-1.0f), zero, done));
+        terminal_mask[i / 32] |= static_cast<std::uint32_t>(_mm256_movemask_ps(done)) << (i % 32);
+    }
+#endif
+    for (; i < size(); ++i)
+    {
+        float a = static_cast<float>(actions[i]) - 1.0f;
+        float x = positions[i];
+        float v = velocities[i];
+
+        float gravity = 0.0025f * cos_approx(3.0f * x);
+        v = (v + 0.001f * a) - gravity;
+        v = std::min(std::max(v, -0.07f), 0.07f);
+        x = std::min(std::max(x + v, -1.2f), 0.5f);
+
+        v = (x == -1.2f) ? 0.0f : v;
+        const bool done = x == 0.5f;
+
+        positions[i] = x;
+        velocities[i] = v;
+        rewards[i] = done ? 0.0f : -1.0f;
+        terminal_mask[i / 32] |= std::uint32_t{done} << (i % 32);
+    }
+
+    // Cars at the goal start their next episode
+    for (std::size_t word = 0; word < terminal_mask.size(); ++word)
+        for (std::uint32_t mask = terminal_mask[word]; mask != 0; mask &= mask - 1)
+            start_car(word * 32 + __builtin_ctz(mask));
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rng.hpp"
+#include "rl_environment.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace rl;
+using namespace env;
+
+/* cos(x) for |x| <= 2 pi, to within a few float ulps: x is reduced to
+ * [-pi, pi], folded onto [0, pi / 2] and the Taylor series summed to the
+ * x^12 term. The AVX2 version makes the same operations in the same order,
+ * so both give the same bits.
+ */
+inline float cos_approx(float x)
+{
+    constexpr float two_pi = 6.28318530717958647692f;
+    constexpr float pi = 3.14159265358979323846f;
+    constexpr float half_pi = 1.57079632679489661923f;
+
+    float t = x - two_pi * std::nearbyint(x * (1.0f / two_pi));
+    t = (t < 0.0f) ? -t : t;
+    const bool flip = t > half_pi;
+    t = flip ? pi - t : t;
+
+    const float t2 = t * t;
+    float c = 1.0f / 479001600.0f;
+    c = c * t2 - 1.0f / 3628800.0f;
+    c = c * t2 + 1.0f / 40320.0f;
+    c = c * t2 - 1.0f / 720.0f;
+    c = c * t2 + 1.0f / 24.0f;
+    c = c * t2 - 0.5f;
+    c = c * t2 + 1.0f;
+    return flip ? -c : c;
+}
+
+#ifdef __AVX2__
+inline __m256 cos_approx(__m256 x)
+{
+    const __m256 two_pi = _mm256_set1_ps(6.28318530717958647692f);
+    const __m256 pi = _mm256_set1_ps(3.14159265358979323846f);
+    const __m256 half_pi = _mm256_set1_ps(1.57079632679489661923f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / 6.28318530717958647692f)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 t = _mm256_andnot_ps(sign, _mm256_sub_ps(x, _mm256_mul_ps(two_pi, k)));
+    __m256 flip = _mm256_cmp_ps(t, half_pi, _CMP_GT_OQ);
+    t = _mm256_blendv_ps(t, _mm256_sub_ps(pi, t), flip);
+
+    const __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 c = _mm256_set1_ps(1.0f / 479001600.0f);
+    c = _mm256_sub_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(1.0f / 3628800.0f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(1.0f / 40320.0f));
+    c = _mm256_sub_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(1.0f / 720.0f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(1.0f / 24.0f));
+    c = _mm256_sub_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(0.5f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, t2), _mm256_set1_ps(1.0f));
+    return _mm256_xor_ps(c, _mm256_and_ps(flip, sign));
+}
+#endif
+
+/* Mountain car for many cars at once, held as structure of arrays so that a
+ * step advances eight cars per AVX2 instruction, without branches. Car i
+ * draws its start positions from the stream a MountainCarEnvironment with
+ * run params.run + i would use, so a batch runs those seeds in lockstep.
+ *
+ * A car that reaches the goal is reported with a zero reward and its bit set
+ * in the terminal mask, and its state is already the start of its next
+ * episode.
+ */
+class MountainCarBatchEnv
+{
+public:
+    void env_init(const EnvironmentInit params, const std::size_t num_cars);
+    // Starts an episode for every car
+    void env_start();
+    // Steps every car i with actions[i]
+    void env_step(const Action* actions);
+
+    std::size_t size() const { return positions.size(); }
+    State get_state(const std::size_t car) const { return {positions[car], velocities[car]}; }
+    const float* get_positions() const { return positions.data(); }
+    const float* get_velocities() const { return velocities.data(); }
+    const float* get_rewards() const { return rewards.data(); }
+    // Bit car % 32 of word car / 32 is set when the car reached the goal
+    const std::uint32_t* get_terminal_mask() const { return terminal_mask.data(); }
+    bool is_terminal(const std::size_t car) const
+    {
+        return (terminal_mask[car / 32] >> (car % 32)) & 1;
+    }
+
+private:
+    std::vector<float> positions;
+    std::vector<float> velocities;
+    std::vector<float> rewards;
+    std::vector<std::uint32_t> terminal_mask;
+    std::vector<rng::Engine> gens;  // one per car
+
+    void start_car(const std::size_t car);
+};
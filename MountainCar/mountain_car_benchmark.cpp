@@ -0,0 +1,72 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "rl.hpp"
+#include "mountain_car_environment.hpp"
+#include "sarsa_agent.hpp"
+
+using namespace rl;
+using namespace env;
+using namespace agent;
+
+/* Steps per second of num_runs runs of num_episodes episodes through rl */
+template <class Loop>
+double steps_per_second(Loop& rl, const EnvironmentInit& env_params, AgentInit agent_params,
+                        const unsigned int num_runs, const unsigned int num_episodes)
+{
+    unsigned long total_steps{0};
+    auto tic = std::chrono::steady_clock::now();
+    for (unsigned int run=0; run < num_runs; ++run)
+    {
+        agent_params.run = run;
+        rl.rl_init(env_params, agent_params);
+        for (unsigned int episode=0; episode < num_episodes; ++episode)
+        {
+            rl.rl_episode(15000);
+            total_steps += rl.rl_num_steps();
+        }
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+    return total_steps / diff.count();
+}
+
+/* Times the same seeded runs of Sarsa with 8 tilings of 8 x 8 tiles through
+ * RL, which calls the agent and the environment through their virtual
+ * interfaces, and through StaticRL, which binds them at compile time. The
+ * two are timed in turn, and the best of the repeats of each is reported:
+ *
+ *     MountainCarBenchmark [num_runs [num_episodes [num_repeats]]]
+ */
+int main(int argc, char* argv[])
+{
+    if (argc > 4)
+    {
+        std::fprintf(stderr, "usage: %s [num_runs [num_episodes [num_repeats]]]\n", argv[0]);
+        return 1;
+    }
+    const unsigned int num_runs = argc > 1 ? std::stoul(argv[1]) : 20;
+    const unsigned int num_episodes = argc > 2 ? std::stoul(argv[2]) : 200;
+    const unsigned int num_repeats = argc > 3 ? std::stoul(argv[3]) : 5;
+
+    AgentInit agent_params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+    EnvironmentInit env_params = {0, true};
+
+    std::shared_ptr<Agent> agent = std::make_shared<SarsaAgent>();
+    std::shared_ptr<Environment> env = std::make_shared<MountainCarEnvironment>();
+    RL virtual_rl(env, agent);
+    StaticRL<MountainCarEnvironment, SarsaAgent> static_rl;
+    double virtual_rate{0}, static_rate{0};
+    for (unsigned int repeat=0; repeat < num_repeats; ++repeat)
+    {
+        virtual_rate = std::max(virtual_rate,
+                steps_per_second(virtual_rl, env_params, agent_params, num_runs, num_episodes));
+        static_rate = std::max(static_rate,
+                steps_per_second(static_rl, env_params, agent_params, num_runs, num_episodes));
+    }
+    std::printf("%u runs of %u episodes, best of %u: RL %.0f steps/s, StaticRL %.0f steps/s (%.2fx)\n",
+            num_runs, num_episodes, num_repeats, virtual_rate, static_rate, static_rate / virtual_rate);
+}
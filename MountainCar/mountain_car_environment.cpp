@@ -2,7 +2,6 @@
 #include <cassert>
 #include <cmath>
 #include <stdexcept>
-#include <type_traits>
 #include "mountain_car_environment.hpp"
 
 using namespace rl;
@@ -29,12 +28,10 @@ using namespace env;
  */
 void MountainCarEnvironment::env_init(const EnvironmentInit params)
 {
-    if (std::is_empty<EnvironmentInit>::value)
-        (void)params;
-
-
-    gen = std::mt19937(std::random_device{}());
-    rand_real = std::uniform_real_distribution<>(-0.6, -0.4);
+    if (params.use_seed)
+        gen = rng::make_engine(params.seed, params.run, rng::env_stream);
+    else
+        gen = rng::make_engine(std::random_device{}());
 
     current_state = {};
 }
@@ -49,7 +46,7 @@ Observation MountainCarEnvironment::env_start()
     // this game is continuous; termination criteria will be some number of steps
     num_steps = 1;
 
-    current_state = {rand_real(gen), 0};
+    current_state = {static_cast<float>(rng::uniform(gen, -0.6, -0.4)), 0};
 
     Observation observation = { 0, convert_to_linear_state(current_state), false };
     return observation;
@@ -73,9 +70,10 @@ Observation MountainCarEnvironment::env_step(const Action action)
                           -0.07, 0.07);
     position = clamp<float>(position + velocity, -1.2, 0.5);
 
-    if (position == -1.2)
+    // Compare with the float bounds the clamp returns
+    if (position == -1.2f)
         velocity = 0.0;
-    else if (position == 0.5)
+    else if (position == 0.5f)
     {
         is_terminal = true;
         reward = 0.0;
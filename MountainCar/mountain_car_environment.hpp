@@ -2,6 +2,7 @@
 
 #include <random>
 #include <vector>
+#include "rng.hpp"
 #include "rl_environment.hpp"
 
 using namespace rl;
@@ -22,8 +23,7 @@ public:
 private:
     State current_state{};
 
-    std::mt19937 gen;
-    std::uniform_real_distribution<> rand_real;
+    rng::Engine gen;
 
     State convert_to_linear_state(const State& current_state) const;
 
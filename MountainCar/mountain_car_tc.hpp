@@ -1,33 +1,111 @@
 //#pragma once
 
+#include <array>
+#include <limits>
 #include "tc.hpp"
 
 using namespace tc;
 
 namespace mctc {
 
-class MountainCarTileCoder : TileCoder
+class MountainCarTileCoder
 {
 public:
-    MountainCarTileCoder() : TileCoder() {};
+    MountainCarTileCoder() {};
     ~MountainCarTileCoder() {};
 
-    void initialize(const std::size_t capacity, const std::uint32_t _num_tilings, const std::uint32_t _num_tiles)
+    /* With TileIndexing::Dense the tiles are indexed directly and capacity
+     * only bounds the number of indices, which depends on num_tilings and
+     * num_tiles alone.
+     */
+    void initialize(const std::size_t capacity, const std::uint32_t _num_tilings, const std::uint32_t _num_tiles,
+                    const OverflowPolicy overflow_policy = OverflowPolicy::Throw,
+                    const TileIndexing _indexing = TileIndexing::Hashed)
     {
-      tc.set_capacity(capacity);
+      tc.clear();
       num_tilings = _num_tilings;
       num_tiles = _num_tiles;
+      indexing = _indexing;
+
+      // The hash table is only sized when it is used
+      tc.share_table(nullptr);
+      tc.set_overflow_policy(overflow_policy);
+      tc.set_capacity(indexing == TileIndexing::Hashed ? capacity : 0);
+
+      if (indexing == TileIndexing::Dense)
+      {
+        dense_tc.initialize(num_tilings, {num_tiles, num_tiles});
+        if (dense_tc.get_size() > capacity)
+            throw(std::out_of_range("Dense tile coder needs more indices than capacity"));
+      }
     }
 
     /* Takes in a position and velocity from the mountain car environment
-     * and returns a vector of active tiles.
+     * and writes the active tiles into a caller owned buffer.
      * Arguments:
      *   position -- float, the position of the agent between -1.2 and 0.5
      *   velocity -- float, the velocity of the agent between -0.07 and 0.07
-     * Returns:
+     *   tiles -- buffer receiving num_tilings active tiles
+     */
+    void get_tiles(const float position, const float velocity, Tiles& tiles)
+    {
+        TileCoder<2>::Floats floats = scale(position, velocity);
+        if (indexing == TileIndexing::Dense)
+            dense_tc.get_tiles(floats, tiles);
+        else
+            tc.get_tiles(num_tilings, floats, tiles);
+    }
+
+    /* Returns:
      *   tiles - vector of active tiles
      */
     std::vector<std::uint32_t> get_tiles(const float position, const float velocity)
+    {
+        Tiles tiles;
+        get_tiles(position, velocity, tiles);
+        return std::vector<std::uint32_t>(tiles.begin(), tiles.end());
+    }
+
+    /* Codes n states at once, writing an n x num_tilings row major matrix
+     * of active tiles to tiles, row i for (positions[i], velocities[i]).
+     */
+    void get_tiles(const float* positions, const float* velocities, const std::size_t n, std::uint32_t* tiles)
+    {
+        constexpr std::size_t block_size = 256;
+        std::array<float, block_size> position_scaled, velocity_scaled;
+        for (std::size_t first = 0; first < n; first += block_size)
+        {
+            const std::size_t count = std::min(n - first, block_size);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto floats = scale(positions[first + i], velocities[first + i]);
+                position_scaled[i] = floats[0];
+                velocity_scaled[i] = floats[1];
+            }
+
+            const TileCoder<2>::FloatArrays floats{position_scaled.data(), velocity_scaled.data()};
+            std::uint32_t* block_tiles = tiles + first * num_tilings;
+            if (indexing == TileIndexing::Dense)
+                dense_tc.get_tiles_batch(floats, count, block_tiles);
+            else
+                tc.get_tiles_batch(num_tilings, floats, count, block_tiles);
+        }
+    }
+
+    // Hashed tiles are looked up in a table shared with other coders, e.g. a
+    // ConcurrentIndexHashTable or a MappedIndexHashTable of a saved table
+    void share_table(std::shared_ptr<TileCoder<2>::SharedTable> table) { tc.share_table(std::move(table)); }
+    void save_table(const std::string& path) const { tc.save_table(path); }
+
+    std::size_t get_collision_count() const { return tc.get_collision_count(); }
+    // Number of indices in use, or all the dense coder can produce
+    std::size_t get_size()
+    {
+        return (indexing == TileIndexing::Dense) ? dense_tc.get_size() : tc.get_size();
+    }
+
+private:
+    TileCoder<2>::Floats scale(const float position, const float velocity) const
     {
         static constexpr float min_float = std::numeric_limits<float>::epsilon();
 
@@ -36,13 +114,12 @@ public:
         float position_scaled = (position - (-1.2)) / (0.5 - (-1.2)) * num_tiles + min_float;
         float velocity_scaled = (velocity - (-0.07)) / (0.07 - (-0.07)) * num_tiles + min_float;
 
-        std::vector<float> floats = {position_scaled, velocity_scaled};
-        //std::printf("%f, %f, %f, %f\n", position, velocity, floats[0], floats[1]);
-        return tc.get_tiles(num_tilings, floats);
+        return {position_scaled, velocity_scaled};
     }
 
-private:
-    TileCoder tc;
+    TileCoder<2> tc;
+    DenseTileCoder<2> dense_tc;
+    TileIndexing indexing{TileIndexing::Hashed};
     std::uint32_t  num_tilings{0};
     std::uint32_t num_tiles{0};
 };
@@ -0,0 +1,1162 @@
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "rl.hpp"
+#include "result_file.hpp"
+#include "run_executor.hpp"
+#include "sweep.hpp"
+#include "mountain_car_environment.hpp"
+#include "mountain_car_batch_env.hpp"
+#include "sarsa_agent.hpp"
+
+using namespace rl;
+using namespace env;
+using namespace agent;
+
+// Count every heap allocation made by the process
+static std::atomic<std::size_t> num_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    ++num_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+/* Drive the agent and environment directly for a number of steps,
+ * restarting the episode whenever the environment terminates.
+ */
+void run_steps(SarsaAgent& agent, MountainCarEnvironment& env,
+               Observation& obs, unsigned int num_steps)
+{
+    for (unsigned int i=0; i < num_steps; ++i)
+    {
+        Action action = agent.agent_step(obs.reward, obs.state);
+        obs = env.env_step(action);
+        if (obs.termination)
+        {
+            agent.agent_end(obs.reward);
+            obs = env.env_start();
+            agent.agent_start(obs.state);
+        }
+    }
+}
+
+/* Feeds the agent a seeded sequence of random states and returns its actions */
+std::vector<Action> run_agent(const unsigned int seed,
+                              std::shared_ptr<tc::SharedIndexTable<3>> table,
+                              const std::string& save_path = "",
+                              const WeightLayout layout = WeightLayout::ActionMajor)
+{
+    SarsaAgent agent;
+    AgentInit agent_params{3, 0, 0.1, 0.5 / 8, 1.0, seed, 8, 8, 4096};
+    agent_params.shared_index_table = table;
+    agent_params.weight_layout = layout;
+    agent.agent_init(agent_params);
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> position(-1.2, 0.5), velocity(-0.07, 0.07);
+
+    std::vector<Action> actions;
+    actions.push_back(agent.agent_start({position(gen), velocity(gen)}));
+    for (int i=0; i < 2000; ++i)
+        actions.push_back(agent.agent_step(-1, {position(gen), velocity(gen)}));
+
+    if (!save_path.empty())
+        agent.agent_message("save index table " + save_path);
+    return actions;
+}
+
+/* Steps taken in each of a number of episodes of a seeded environment */
+template <class AgentType = SarsaAgent>
+std::vector<unsigned int> learning_curve(const unsigned int seed, const bool cache_action_values,
+                                         const float lambda = 0)
+{
+    AgentType agent;
+    MountainCarEnvironment env;
+    AgentInit agent_params{3, 0, 0.1, 0.5 / 8, 1.0, seed, 8, 8, 4096};
+    agent_params.cache_action_values = cache_action_values;
+    agent_params.lambda = lambda;
+    agent_params.trace_type = TraceType::Replacing;
+    EnvironmentInit env_params;
+    env_params.seed = seed;
+    env_params.use_seed = true;
+    agent.agent_init(agent_params);
+    env.env_init(env_params);
+
+    std::vector<unsigned int> steps;
+    for (int episode=0; episode < 50; ++episode)
+    {
+        Observation obs = env.env_start();
+        Action action = agent.agent_start(obs.state);
+        unsigned int num_steps = 1;
+        for (obs = env.env_step(action); !obs.termination && num_steps < 15000; obs = env.env_step(action))
+        {
+            action = agent.agent_step(obs.reward, obs.state);
+            ++num_steps;
+        }
+        agent.agent_end(obs.reward);
+        steps.push_back(num_steps);
+    }
+    return steps;
+}
+
+/* An RL loop that counts its starts and steps, as a subclass may */
+class CountingRL : public RL
+{
+public:
+    using RL::RL;
+
+    std::pair<State, Action> rl_start() override
+    {
+        ++num_starts;
+        return RL::rl_start();
+    }
+    std::tuple<Observation, Action> rl_step() override
+    {
+        ++num_steps_taken;
+        return RL::rl_step();
+    }
+
+    unsigned int num_starts{0};
+    unsigned int num_steps_taken{0};
+};
+
+/* Steps taken in each of a few episodes of a seeded environment by agent,
+ * initialized with agent_params first
+ */
+std::vector<unsigned int> episode_steps(SarsaAgent& agent, const AgentInit& agent_params)
+{
+    MountainCarEnvironment env;
+    EnvironmentInit env_params{0, true};
+    agent.agent_init(agent_params);
+    env.env_init(env_params);
+
+    std::vector<unsigned int> steps;
+    for (int episode=0; episode < 5; ++episode)
+    {
+        Observation obs = env.env_start();
+        Action action = agent.agent_start(obs.state);
+        unsigned int num_steps = 1;
+        for (obs = env.env_step(action); !obs.termination && num_steps < 15000; obs = env.env_step(action))
+        {
+            action = agent.agent_step(obs.reward, obs.state);
+            ++num_steps;
+        }
+        agent.agent_end(obs.reward);
+        steps.push_back(num_steps);
+    }
+    return steps;
+}
+
+int main()
+{
+    std::printf("Mountain Car Test\n");
+
+    SarsaAgent agent;
+    MountainCarEnvironment env;
+
+    AgentInit agent_params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+    EnvironmentInit env_params;
+
+    agent.agent_init(agent_params);
+    env.env_init(env_params);
+
+    Observation obs = env.env_start();
+    agent.agent_start(obs.state);
+
+    // Warm up, then no step may touch the heap
+    run_steps(agent, env, obs, 1000);
+
+    std::size_t before = num_allocations;
+    run_steps(agent, env, obs, 10000);
+    std::size_t allocations = num_allocations - before;
+
+    bool pass = allocations == 0;
+    if (!pass)
+        std::printf("test failed!\n%zu allocations in 10000 steps\n", allocations);
+    std::printf("Mountain Car Allocation Test %s\n", pass ? "Passed" : "Failed");
+
+    // The dense coder must produce the same tiles as the hashed one, only
+    // numbered differently, for every option used by mountain_car.cpp
+    pass = true;
+    const std::pair<unsigned int, unsigned int> options[] = { {2, 16}, {32, 4}, {8, 8} };
+    for (const auto& opt : options)
+    {
+        MountainCarTileCoder hashed_tc, dense_tc;
+        hashed_tc.initialize(4096, opt.first, opt.second);
+        dense_tc.initialize(4096, opt.first, opt.second, OverflowPolicy::Throw, TileIndexing::Dense);
+
+        std::map<uint32_t, uint32_t> to_dense, to_hashed;
+        for (int i=0; i <= 50; ++i)
+            for (int j=0; j <= 50; ++j)
+            {
+                float position = -1.2 + i * 1.7 / 50;
+                float velocity = -0.07 + j * 0.14 / 50;
+                auto tiles = hashed_tc.get_tiles(position, velocity);
+                auto dense_tiles = dense_tc.get_tiles(position, velocity);
+                for (std::size_t k=0; k < tiles.size(); ++k)
+                {
+                    auto h = to_dense.emplace(tiles[k], dense_tiles[k]).first;
+                    auto d = to_hashed.emplace(dense_tiles[k], tiles[k]).first;
+                    if (h->second != dense_tiles[k] || d->second != tiles[k] ||
+                        dense_tiles[k] >= dense_tc.get_size())
+                    {
+                        pass = false;
+                        std::printf("test failed!\n(%f, %f) tiling %zu: hashed %u, dense %u\n",
+                                position, velocity, k, tiles[k], dense_tiles[k]);
+                    }
+                }
+            }
+    }
+    std::printf("Mountain Car Dense Tile Coder Test %s\n", pass ? "Passed" : "Failed");
+
+    // Coding a batch of states gives the indices one call per state would
+    pass = true;
+    for (auto indexing : { TileIndexing::Hashed, TileIndexing::Dense })
+        for (const auto& opt : options)
+        {
+            const std::size_t n = 1000;
+            std::mt19937 gen(0);
+            std::uniform_real_distribution<float> position_dist(-1.2, 0.5), velocity_dist(-0.07, 0.07);
+            std::vector<float> positions(n), velocities(n);
+            for (std::size_t i=0; i < n; ++i)
+            {
+                positions[i] = position_dist(gen);
+                velocities[i] = velocity_dist(gen);
+            }
+
+            MountainCarTileCoder single_tc, batch_tc;
+            single_tc.initialize(4096, opt.first, opt.second, OverflowPolicy::Throw, indexing);
+            batch_tc.initialize(4096, opt.first, opt.second, OverflowPolicy::Throw, indexing);
+
+            std::vector<uint32_t> batch_tiles(n * opt.first);
+            batch_tc.get_tiles(positions.data(), velocities.data(), n, batch_tiles.data());
+            for (std::size_t i=0; i < n; ++i)
+            {
+                auto tiles = single_tc.get_tiles(positions[i], velocities[i]);
+                for (std::size_t k=0; k < tiles.size(); ++k)
+                    if (tiles[k] != batch_tiles[i * opt.first + k])
+                    {
+                        pass = false;
+                        std::printf("test failed!\nstate %zu tiling %zu: %u instead of %u\n",
+                                i, k, batch_tiles[i * opt.first + k], tiles[k]);
+                    }
+            }
+        }
+    std::printf("Mountain Car Batch Tile Coder Test %s\n", pass ? "Passed" : "Failed");
+
+    // Agents on several threads sharing one index table act exactly as
+    // agents with tables of their own
+    pass = true;
+    {
+        constexpr unsigned int num_threads = 4;
+        auto table = std::make_shared<tc::ConcurrentIndexHashTable<3>>(4096);
+        std::vector<std::vector<Action>> shared_actions(num_threads);
+        std::vector<std::thread> threads;
+        for (unsigned int t=0; t < num_threads; ++t)
+            threads.emplace_back([&, t]() { shared_actions[t] = run_agent(t, table); });
+        for (auto& thread : threads)
+            thread.join();
+
+        for (unsigned int t=0; t < num_threads; ++t)
+            if (shared_actions[t] != run_agent(t, nullptr))
+            {
+                pass = false;
+                std::printf("test failed!\nseed %u acted differently with a shared table\n", t);
+            }
+
+        // 8 tilings of 9 x 11 tiles at most
+        if (table->get_size() == 0 || table->get_size() > 8 * 9 * 11 || table->get_collision_count() != 0)
+        {
+            pass = false;
+            std::printf("test failed!\nshared table holds %zu keys\n", table->get_size());
+        }
+
+        table->freeze();
+        std::size_t size = table->get_size();
+        run_agent(num_threads, table);
+        if (table->get_size() != size)
+        {
+            pass = false;
+            std::printf("test failed!\nfrozen table grew to %zu keys\n", table->get_size());
+        }
+
+        // The same workload again on a fresh table: the threads interleave
+        // differently, but the keys and what every agent does are the same
+        auto second_table = std::make_shared<tc::ConcurrentIndexHashTable<3>>(4096);
+        std::vector<std::vector<Action>> second_actions(num_threads);
+        threads.clear();
+        for (unsigned int t=0; t < num_threads; ++t)
+            threads.emplace_back([&, t]() { second_actions[t] = run_agent(t, second_table); });
+        for (auto& thread : threads)
+            thread.join();
+        if (second_actions != shared_actions || second_table->get_size() != size)
+        {
+            pass = false;
+            std::printf("test failed!\na second run on %u threads acted differently\n", num_threads);
+        }
+
+        // Folding keys once the table is full would make which keys collide
+        // depend on the interleaving
+        for (auto policy : {tc::OverflowPolicy::Fold, tc::OverflowPolicy::HashOnly})
+        {
+            bool threw = false;
+            try
+            {
+                tc::ConcurrentIndexHashTable<3> folding(4096, policy);
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            if (!threw)
+            {
+                pass = false;
+                std::printf("test failed!\nshared table accepted an overflow policy other than Throw\n");
+            }
+        }
+
+        // A full table throws for new keys, and keeps throwing for them
+        tc::ConcurrentIndexHashTable<3> small(2);
+        const tc::ConcurrentIndexHashTable<3>::KeyType a{1, 0, 0}, b{1, 0, 1}, c{1, 1, 0};
+        std::uint32_t ia = small.get_index(a), ib = small.get_index(b);
+        int num_thrown = 0;
+        for (int repeat=0; repeat < 2; ++repeat)
+            try
+            {
+                small.get_index(c);
+            }
+            catch (const std::out_of_range&)
+            {
+                ++num_thrown;
+            }
+        if (ia == ib || small.get_index(a) != ia || small.get_index(b) != ib || num_thrown != 2)
+        {
+            pass = false;
+            std::printf("test failed!\nfull shared table gave %u, %u, threw %d times\n", ia, ib, num_thrown);
+        }
+    }
+    std::printf("Mountain Car Shared Index Table Test %s\n", pass ? "Passed" : "Failed");
+
+    // An agent warm started from a saved table gets the same indices, acts
+    // the same and inserts nothing
+    pass = true;
+    {
+        const std::string path = "mountain_car_test_iht.bin";
+        MountainCarTileCoder saved_tc;
+        saved_tc.initialize(4096, 8, 8);
+        std::vector<std::vector<uint32_t>> saved_tiles;
+        for (int i=0; i <= 20; ++i)
+            for (int j=0; j <= 20; ++j)
+                saved_tiles.push_back(saved_tc.get_tiles(-1.2 + i * 1.7 / 20, -0.07 + j * 0.14 / 20));
+        saved_tc.save_table(path);
+
+        auto table = std::make_shared<tc::MappedIndexHashTable<3>>(path);
+        MountainCarTileCoder mapped_tc;
+        mapped_tc.initialize(4096, 8, 8);
+        mapped_tc.share_table(table);
+        std::size_t k = 0;
+        for (int i=0; i <= 20; ++i)
+            for (int j=0; j <= 20; ++j)
+                if (mapped_tc.get_tiles(-1.2 + i * 1.7 / 20, -0.07 + j * 0.14 / 20) != saved_tiles[k++])
+                {
+                    pass = false;
+                    std::printf("test failed!\nmapped tiles differ for state %zu\n", k - 1);
+                }
+
+        auto actions = run_agent(0, nullptr, path);
+        auto warm_table = std::make_shared<tc::MappedIndexHashTable<3>>(path);
+        if (run_agent(0, warm_table) != actions || warm_table->get_collision_count() != 0)
+        {
+            pass = false;
+            std::printf("test failed!\nwarm started agent acted differently\n");
+        }
+
+        bool threw = false;
+        try
+        {
+            mapped_tc.initialize(4096, 16, 16);
+            mapped_tc.share_table(warm_table);
+            mapped_tc.get_tiles(-0.5, 0.0);
+        }
+        catch (const std::out_of_range&)
+        {
+            threw = true;
+        }
+        if (!threw)
+        {
+            pass = false;
+            std::printf("test failed!\nunknown key did not throw\n");
+        }
+        std::remove(path.c_str());
+    }
+    std::printf("Mountain Car Mapped Index Table Test %s\n", pass ? "Passed" : "Failed");
+
+    // A table keeps its keys when it grows and refuses to shrink below them,
+    // and an agent initialized again, with the same, a smaller or a dense
+    // table, learns as a fresh one does
+    pass = true;
+    {
+        tc::IndexHashTable<3> table(16);
+        for (std::uint32_t i=0; i < 10; ++i)
+            table.get_index({1, i, 0});
+        bool thrown = false;
+        try
+        {
+            table.set_capacity(8);
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        table.set_capacity(64);
+        if (!thrown || table.get_size() != 10 || table.get_index({1, 7, 0}) != 7 || table.get_size() != 10)
+        {
+            pass = false;
+            std::printf("test failed!\na resized table lost its keys\n");
+        }
+        table.clear();
+        table.set_capacity(8);
+
+        AgentInit used_params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+        AgentInit smaller_params = used_params;
+        smaller_params.num_tiles = 4;
+        smaller_params.index_hash_table_size = 256;
+        AgentInit dense_params = used_params;
+        dense_params.tile_indexing = TileIndexing::Dense;
+        for (const AgentInit& params : {used_params, smaller_params, dense_params})
+        {
+            SarsaAgent used, fresh;
+            episode_steps(used, used_params);
+            if (episode_steps(used, params) != episode_steps(fresh, params))
+            {
+                pass = false;
+                std::printf("test failed!\nan agent initialized again learned differently\n");
+            }
+        }
+    }
+    std::printf("Mountain Car Reinitialized Agent Test %s\n", pass ? "Passed" : "Failed");
+
+    // Action values are summed in the same order in both weight layouts, so
+    // the agent acts identically
+    pass = true;
+    for (unsigned int seed=0; seed < 3; ++seed)
+        if (run_agent(seed, nullptr, "", WeightLayout::TileMajor) != run_agent(seed, nullptr))
+        {
+            pass = false;
+            std::printf("test failed!\nseed %u acted differently with tile major weights\n", seed);
+        }
+    std::printf("Mountain Car Weight Layout Test %s\n", pass ? "Passed" : "Failed");
+
+    // Cached action values learn as well as summing them every step: the
+    // cache rounds differently from the sums, and the trajectories part ways
+    // at the first near tie that breaks the other way, so compare the total
+    // steps of a few runs
+    pass = true;
+    {
+        unsigned int summed = 0, cached = 0;
+        for (unsigned int seed=0; seed < 5; ++seed)
+        {
+            for (auto steps : learning_curve(seed, false))
+                summed += steps;
+            for (auto steps : learning_curve(seed, true))
+                cached += steps;
+        }
+        if (std::abs(static_cast<double>(cached) - summed) > 0.1 * summed)
+        {
+            pass = false;
+            std::printf("test failed!\ncached action values took %u steps, summed ones %u\n", cached, summed);
+        }
+    }
+    std::printf("Mountain Car Cached Action Values Test %s\n", pass ? "Passed" : "Failed");
+
+    // Sparse traces hold what a dense trace vector would, less the traces
+    // that decayed below the threshold
+    pass = true;
+    for (auto type : { TraceType::Accumulating, TraceType::Replacing })
+    {
+        constexpr std::size_t num_keys = 64, width = 3;
+        const float threshold = 0.01;
+        EligibilityTraces<float> traces;
+        traces.resize(num_keys, width, type, threshold);
+        std::vector<float> dense(num_keys * width, 0);
+
+        std::mt19937 gen(0);
+        std::uniform_int_distribution<uint32_t> key_dist(0, num_keys - 1);
+        std::uniform_real_distribution<float> value_dist(-1, 1);
+        for (int step=0; step < 1000 && pass; ++step)
+        {
+            for (int j=0; j < 4; ++j)
+            {
+                uint32_t key = key_dist(gen);
+                float gradient[width];
+                for (auto& g : gradient)
+                    g = value_dist(gen);
+                traces.add(key, gradient);
+                for (std::size_t k=0; k < width; ++k)
+                    dense[key * width + k] = (type == TraceType::Replacing) ?
+                            gradient[k] : dense[key * width + k] + gradient[k];
+            }
+
+            traces.decay(0.8);
+            for (std::size_t key=0; key < num_keys; ++key)
+            {
+                float largest = 0;
+                for (std::size_t k=0; k < width; ++k)
+                    largest = std::max(largest, std::abs(dense[key * width + k] *= 0.8f));
+                if (largest < threshold)
+                    std::fill_n(dense.begin() + key * width, width, 0.0f);
+            }
+
+            std::vector<float> sparse(num_keys * width, 0);
+            for (std::size_t i=0; i < traces.size(); ++i)
+                std::copy_n(traces.trace(i), width, sparse.begin() + traces.key(i) * width);
+            if (sparse != dense)
+            {
+                pass = false;
+                std::printf("test failed!\nstep %d: sparse traces differ\n", step);
+            }
+        }
+    }
+
+    // Keys from a huge range cost memory by the active traces only, and
+    // the map finds them through growth and removals
+    {
+        constexpr std::size_t width = 2;
+        EligibilityTraces<float> traces;
+        traces.resize(std::size_t{1} << 31, width, TraceType::Accumulating, 0.01f);
+        std::map<uint32_t, float> reference;
+
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<uint32_t> key_dist(0, 4095);
+        std::size_t most_active = 0;
+        for (int step=0; step < 2000 && pass; ++step)
+        {
+            for (int j=0; j < 8; ++j)
+            {
+                // Keys 2^19 apart, sharing their low bits
+                uint32_t key = key_dist(gen) << 19;
+                const float gradient[width] = {1.0f, -1.0f};
+                traces.add(key, gradient);
+                reference[key] += 1.0f;
+            }
+            traces.decay(0.5);
+            for (auto it = reference.begin(); it != reference.end(); )
+                it = (std::abs(it->second *= 0.5f) < 0.01f) ? reference.erase(it) : std::next(it);
+            most_active = std::max(most_active, reference.size());
+
+            std::map<uint32_t, float> sparse;
+            for (std::size_t i=0; i < traces.size(); ++i)
+                sparse[traces.key(i)] = traces.trace(i)[0];
+            if (sparse != reference || traces.map_capacity() > std::max<std::size_t>(16, 4 * most_active))
+            {
+                pass = false;
+                std::printf("test failed!\nstep %d: %zu traces instead of %zu, map of %zu slots\n",
+                        step, traces.size(), reference.size(), traces.map_capacity());
+            }
+        }
+
+        traces.clear();
+        bool threw = false;
+        try
+        {
+            const float gradient[width] = {1.0f, 1.0f};
+            EligibilityTraces<float> small;
+            small.resize(8, width, TraceType::Accumulating, 0.01f);
+            small.add(8, gradient);
+        }
+        catch (const std::out_of_range&)
+        {
+            threw = true;
+        }
+        if (traces.size() != 0 || !threw)
+        {
+            pass = false;
+            std::printf("test failed!\nclear left %zu traces, key past the range %s\n",
+                    traces.size(), threw ? "rejected" : "accepted");
+        }
+    }
+
+    // and replacing traces reach the goal in fewer steps
+    unsigned int one_step = 0, traced = 0;
+    for (unsigned int seed=0; seed < 3; ++seed)
+    {
+        for (auto steps : learning_curve(seed, false))
+            one_step += steps;
+        for (auto steps : learning_curve(seed, false, 0.9))
+            traced += steps;
+    }
+    if (traced >= one_step)
+    {
+        pass = false;
+        std::printf("test failed!\nSARSA(0.9) took %u steps, SARSA(0) %u\n", traced, one_step);
+    }
+    std::printf("Mountain Car Eligibility Traces Test %s\n", pass ? "Passed" : "Failed");
+
+    // Narrower weights learn as well as double weights: the trajectories
+    // part ways at the first rounding that flips an action, so compare the
+    // total steps of a few runs
+    pass = true;
+    {
+        auto total_steps = [](auto curve) {
+            unsigned int total = 0;
+            for (unsigned int seed=0; seed < 5; ++seed)
+                for (auto steps : curve(seed))
+                    total += steps;
+            return total;
+        };
+        const unsigned int baseline = total_steps([](unsigned int seed) {
+            return learning_curve<SarsaAgentT<double, double>>(seed, false); });
+        const std::pair<const char*, unsigned int> narrow[] = {
+            {"float", total_steps([](unsigned int seed) {
+                return learning_curve<SarsaAgentT<float, float>>(seed, false); })},
+            {"float/double", total_steps([](unsigned int seed) {
+                return learning_curve<SarsaAgentT<float, double>>(seed, false); })},
+            {"bfloat16/float", total_steps([](unsigned int seed) {
+                return learning_curve<SarsaAgentT<bfloat16, float>>(seed, false); })},
+        };
+        for (const auto& [name, total] : narrow)
+        {
+            if (std::abs(static_cast<double>(total) - baseline) > 0.1 * baseline)
+            {
+                pass = false;
+                std::printf("test failed!\n%s weights took %u steps, double weights %u\n",
+                        name, total, baseline);
+            }
+        }
+    }
+    std::printf("Mountain Car Weight Precision Test %s\n", pass ? "Passed" : "Failed");
+
+    // StaticRL runs the same episodes as RL does through the virtual
+    // interfaces
+    pass = true;
+    {
+        AgentInit params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+        EnvironmentInit env_init;
+        env_init.use_seed = true;
+        RL virtual_rl(std::make_shared<MountainCarEnvironment>(), std::make_shared<SarsaAgent>());
+        StaticRL<MountainCarEnvironment, SarsaAgent> static_rl;
+        virtual_rl.rl_init(env_init, params);
+        static_rl.rl_init(env_init, params);
+        for (int episode=0; episode < 20 && pass; ++episode)
+        {
+            virtual_rl.rl_episode(15000);
+            static_rl.rl_episode(15000);
+            if (static_rl.rl_num_steps() != virtual_rl.rl_num_steps() ||
+                static_rl.rl_return() != virtual_rl.rl_return())
+            {
+                pass = false;
+                std::printf("test failed!\nepisode %d: %u steps and return %f instead of %u and %f\n",
+                        episode, static_rl.rl_num_steps(), static_rl.rl_return(),
+                        virtual_rl.rl_num_steps(), virtual_rl.rl_return());
+            }
+        }
+
+        // rl_episode goes through the virtual rl_start and rl_step, so a
+        // subclass sees every start and step; an episode that ends on its
+        // terminal step calls rl_step as often as rl_num_steps counts
+        CountingRL counting_rl(std::make_shared<MountainCarEnvironment>(), std::make_shared<SarsaAgent>());
+        counting_rl.rl_init(env_init, params);
+        unsigned int total_steps = 0;
+        for (int episode=0; episode < 3; ++episode)
+        {
+            counting_rl.rl_episode(15000);
+            total_steps += counting_rl.rl_num_steps();
+        }
+        if (counting_rl.num_starts != 3 || counting_rl.num_steps_taken != total_steps)
+        {
+            pass = false;
+            std::printf("test failed!\nrl_episode made %u of 3 starts and %u of %u steps through the subclass\n",
+                    counting_rl.num_starts, counting_rl.num_steps_taken, total_steps);
+        }
+    }
+    std::printf("Mountain Car Static RL Test %s\n", pass ? "Passed" : "Failed");
+
+    // Runs on several threads take the same steps as the same runs one after
+    // another, and a run that throws stops the study
+    pass = true;
+    {
+        constexpr unsigned int num_runs = 6;
+        constexpr unsigned int num_episodes = 5;
+        AgentInit params{3, 0, 0.1, 0.5 / 8, 1.0, 0, 8, 8, 4096};
+        EnvironmentInit env_init;
+        env_init.use_seed = true;
+
+        std::array<std::array<unsigned int, num_episodes>, num_runs> parallel_steps{}, serial_steps{};
+        RunExecutor executor([]() { return std::make_shared<MountainCarEnvironment>(); },
+                             []() { return std::make_shared<SarsaAgent>(); }, 4);
+        executor.run(num_runs, env_init, params, [&](RL& rl, const unsigned int run)
+        {
+            for (unsigned int episode=0; episode < num_episodes; ++episode)
+            {
+                rl.rl_episode(15000);
+                parallel_steps[run][episode] = rl.rl_num_steps();
+            }
+        });
+
+        StaticRL<MountainCarEnvironment, SarsaAgent> rl;
+        for (unsigned int run=0; run < num_runs; ++run)
+        {
+            env_init.run = params.run = run;
+            rl.rl_init(env_init, params);
+            for (unsigned int episode=0; episode < num_episodes; ++episode)
+            {
+                rl.rl_episode(15000);
+                serial_steps[run][episode] = rl.rl_num_steps();
+            }
+        }
+        if (parallel_steps != serial_steps)
+        {
+            pass = false;
+            std::printf("test failed!\nparallel runs took different steps\n");
+        }
+
+        bool thrown = false;
+        try
+        {
+            executor.run(num_runs, env_init, params, [](RL&, const unsigned int run)
+            {
+                if (run == 3)
+                    throw std::runtime_error("run 3");
+            });
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        if (!thrown)
+        {
+            pass = false;
+            std::printf("test failed!\nthe exception of run 3 was lost\n");
+        }
+    }
+    std::printf("Mountain Car Run Executor Test %s\n", pass ? "Passed" : "Failed");
+
+    // A sweep runs every cell of its grid once, with the steps of serial
+    // runs, and when started again runs only the cells missing from its
+    // results file
+    pass = true;
+    {
+        std::vector<std::atomic<int>> counts(100);
+        run_work_stealing(counts.size(), 4, [&](const std::size_t task) { ++counts[task]; });
+        if (std::any_of(counts.begin(), counts.end(), [](const std::atomic<int>& n) { return n != 1; }))
+        {
+            pass = false;
+            std::printf("test failed!\nwork stealing ran a task other than once\n");
+        }
+
+        const std::string config_path = "mountain_car_test_sweep.cfg";
+        const std::string results_path = "mountain_car_test_sweep.txt";
+        std::remove(results_path.c_str());
+        std::ofstream(config_path) << "# a small grid\n"
+                                   << "num_runs = 2\n"
+                                   << "results = " << results_path << "\n"
+                                   << "num_episodes = 3  # a setting of the driver\n"
+                                   << "num_tilings = 4, 8\n"
+                                   << "step_size = 0.125, 0.0625\n";
+
+        AgentInit params{3, 0, 0.1, 0.5, 1.0, 0, 8, 8, 4096};
+        EnvironmentInit env_init;
+        env_init.use_seed = true;
+        auto make_env = []() { return std::make_shared<MountainCarEnvironment>(); };
+        auto make_agent = []() { return std::make_shared<SarsaAgent>(); };
+        auto run_cell = [](RL& rl, const Sweep::Config& config, const unsigned int)
+        {
+            std::vector<double> steps(std::stoul(Sweep::get_value(config, "num_episodes", "1")));
+            for (auto& episode_steps : steps)
+            {
+                rl.rl_episode(15000);
+                episode_steps = rl.rl_num_steps();
+            }
+            return steps;
+        };
+
+        Sweep sweep(config_path, env_init, params, {"num_episodes"});
+        const Sweep::Config second = {{"num_episodes", "3"}, {"num_tilings", "4"}, {"step_size", "0.0625"}};
+        if (sweep.get_num_configs() != 4 || sweep.get_config(1) != second)
+        {
+            pass = false;
+            std::printf("test failed!\n%zu configs in the grid\n", sweep.get_num_configs());
+        }
+        std::size_t num_cells = sweep.run(make_env, make_agent, run_cell, 3);
+
+        StaticRL<MountainCarEnvironment, SarsaAgent> rl;
+        for (std::size_t config=0; config < sweep.get_num_configs() && pass; ++config)
+            for (unsigned int run=0; run < 2; ++run)
+            {
+                AgentInit cell_params = params;
+                for (const auto& param : sweep.get_config(config))
+                    set_agent_param(cell_params, param.first, param.second);
+                env_init.run = cell_params.run = run;
+                rl.rl_init(env_init, cell_params);
+                std::vector<double> steps;
+                for (int episode=0; episode < 3; ++episode)
+                {
+                    rl.rl_episode(15000);
+                    steps.push_back(rl.rl_num_steps());
+                }
+                if (sweep.get_result(config, run) != steps)
+                {
+                    pass = false;
+                    std::printf("test failed!\nconfig %zu run %u took other steps than a serial run\n", config, run);
+                }
+            }
+
+        // Cut the last cell short, as if the sweep had been stopped writing it
+        std::ifstream results_file(results_path);
+        std::string results((std::istreambuf_iterator<char>(results_file)), std::istreambuf_iterator<char>());
+        results_file.close();
+        std::ofstream(results_path) << results.substr(0, results.size() - 5);
+
+        Sweep resumed(config_path, env_init, params, {"num_episodes"});
+        std::size_t num_resumed_cells = resumed.run(make_env, make_agent, run_cell, 3);
+        if (num_cells != 8 || num_resumed_cells != 1)
+        {
+            pass = false;
+            std::printf("test failed!\n%zu cells run, then %zu on resuming\n", num_cells, num_resumed_cells);
+        }
+        for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
+            for (unsigned int run=0; run < 2; ++run)
+                if (resumed.get_result(config, run) != sweep.get_result(config, run))
+                {
+                    pass = false;
+                    std::printf("test failed!\nconfig %zu run %u read back differently\n", config, run);
+                }
+
+        // Cells are keyed by what they ran with, so other defaults, or
+        // another environment seed, resume none of them
+        AgentInit other_params = params;
+        other_params.epsilon = 0.2;
+        EnvironmentInit other_env_init = env_init;
+        other_env_init.seed = 1;
+        Sweep other_defaults(config_path, env_init, other_params, {"num_episodes"});
+        Sweep other_seed(config_path, other_env_init, params, {"num_episodes"});
+        for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
+            for (unsigned int run=0; run < 2; ++run)
+                if (other_defaults.has_result(config, run) || other_seed.has_result(config, run))
+                {
+                    pass = false;
+                    std::printf("test failed!\nconfig %zu run %u resumed with other defaults\n", config, run);
+                }
+
+        // Fields the config leaves out are completed from those it sets
+        const std::string completed_path = "mountain_car_test_completed.txt";
+        std::remove(completed_path.c_str());
+        std::ofstream(config_path) << "num_runs = 1\n"
+                                   << "results = " << completed_path << "\n"
+                                   << "num_episodes = 3\n"
+                                   << "num_tilings = 4, 8\n";
+        Sweep completed(config_path, env_init, params, {"num_episodes"},
+                        [](AgentInit& config_params, const Sweep::Config& config) {
+                            if (Sweep::get_value(config, "step_size", "").empty())
+                                config_params.step_size = 0.5 / config_params.num_tilings;
+                        });
+        completed.run(make_env, make_agent, run_cell, 2);
+        for (std::size_t config=0; config < completed.get_num_configs(); ++config)
+        {
+            // Configs 0 and 3 of the grid above set the same step sizes
+            if (completed.get_result(config, 0) != sweep.get_result(config == 0 ? 0 : 3, 0))
+            {
+                pass = false;
+                std::printf("test failed!\nconfig %zu did not scale its step size\n", config);
+            }
+        }
+        std::remove(completed_path.c_str());
+
+        bool thrown = false;
+        std::ofstream(config_path) << "mode = list\nnum_tilings = 4, 8\nnum_tiles = 2, 4, 8\n";
+        try
+        {
+            Sweep mismatched(config_path, env_init, params);
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        if (!thrown)
+        {
+            pass = false;
+            std::printf("test failed!\nlists of 2 and 3 values were accepted\n");
+        }
+
+        // Names that are no AgentInit field nor a declared setting, and
+        // values a field cannot take, are rejected before anything runs
+        for (const char* config : {"num_episode = 3\n", "num_episodes = 3\nstep_sise = 0.125\n",
+                                   "num_tilings = 4, four\n", "trace_type = Dutch\n"})
+        {
+            std::ofstream(config_path) << config;
+            thrown = false;
+            try
+            {
+                Sweep rejected(config_path, env_init, params, {"num_episodes"});
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+            if (!thrown)
+            {
+                pass = false;
+                std::printf("test failed!\nthe config \"%s\" was accepted\n", config);
+            }
+        }
+        std::ofstream(config_path) << "num_episodes = 3\n";
+        thrown = false;
+        try
+        {
+            Sweep undeclared(config_path, env_init, params);
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        if (!thrown)
+        {
+            pass = false;
+            std::printf("test failed!\na setting the driver does not declare was accepted\n");
+        }
+
+        std::remove(config_path.c_str());
+        std::remove(results_path.c_str());
+    }
+    std::printf("Mountain Car Sweep Test %s\n", pass ? "Passed" : "Failed");
+
+    // Worker processes sharing a queue directory run each cell once, and
+    // merging their shards gives the results of a sweep in one process
+    pass = true;
+    {
+        const std::string config_path = "mountain_car_test_workers.cfg";
+        const std::string results_path = "mountain_car_test_workers.txt";
+        const std::string queue_dir = "mountain_car_test_queue";
+        std::remove(results_path.c_str());
+        std::filesystem::remove_all(queue_dir);
+        std::ofstream(config_path) << "num_runs = 4\n"
+                                   << "results = " << results_path << "\n"
+                                   << "num_episodes = 2\n"
+                                   << "num_tilings = 4, 8\n"
+                                   << "step_size = 0.125\n";
+
+        AgentInit params{3, 0, 0.1, 0.5, 1.0, 0, 8, 8, 4096};
+        EnvironmentInit env_init;
+        env_init.use_seed = true;
+        auto make_env = []() { return std::make_shared<MountainCarEnvironment>(); };
+        auto make_agent = []() { return std::make_shared<SarsaAgent>(); };
+        auto run_cell = [](RL& rl, const Sweep::Config& config, const unsigned int)
+        {
+            std::vector<double> steps(std::stoul(Sweep::get_value(config, "num_episodes", "1")));
+            for (auto& episode_steps : steps)
+            {
+                rl.rl_episode(15000);
+                episode_steps = rl.rl_num_steps();
+            }
+            return steps;
+        };
+
+        // Each worker reports the cells it ran as its exit status
+        constexpr int num_workers = 3;
+        std::vector<pid_t> workers;
+        for (int w=0; w < num_workers; ++w)
+        {
+            const pid_t pid = fork();
+            if (pid == 0)
+            {
+                int num_cells = -1;
+                try
+                {
+                    Sweep sweep(config_path, env_init, params, {"num_episodes"});
+                    num_cells = sweep.run_worker(queue_dir, make_env, make_agent, run_cell, 1);
+                }
+                catch (...)
+                {
+                }
+                _exit(num_cells < 0 ? 255 : num_cells);
+            }
+            workers.push_back(pid);
+        }
+        int num_cells = 0;
+        for (const pid_t pid : workers)
+        {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) == 255)
+            {
+                pass = false;
+                std::printf("test failed!\nworker %d failed\n", pid);
+            }
+            num_cells += WEXITSTATUS(status);
+        }
+
+        Sweep merged(config_path, env_init, params, {"num_episodes"});
+        const std::size_t num_missing = merged.merge(queue_dir);
+        std::remove(results_path.c_str());
+        Sweep serial(config_path, env_init, params, {"num_episodes"});
+        serial.run(make_env, make_agent, run_cell, 1);
+        if (num_cells != 8 || num_missing != 0)
+        {
+            pass = false;
+            std::printf("test failed!\nworkers ran %d cells, %zu missing\n", num_cells, num_missing);
+        }
+        for (std::size_t config=0; config < serial.get_num_configs() && num_missing == 0; ++config)
+            for (unsigned int run=0; run < 4; ++run)
+                if (merged.get_result(config, run) != serial.get_result(config, run))
+                {
+                    pass = false;
+                    std::printf("test failed!\nconfig %zu run %u differs from a serial sweep\n", config, run);
+                }
+
+        std::remove(config_path.c_str());
+        std::remove(results_path.c_str());
+        std::filesystem::remove_all(queue_dir);
+    }
+    std::printf("Mountain Car Sweep Worker Test %s\n", pass ? "Passed" : "Failed");
+
+    // The batch steps every car as MountainCarEnvironment steps the same run,
+    // up to its cosine and float arithmetic, starting the same episodes
+    pass = true;
+    {
+        float worst_cos = 0;
+        for (float x = -3.6f; x <= 1.5f; x += 1e-4f)
+            worst_cos = std::max(worst_cos, std::abs(cos_approx(x) - static_cast<float>(std::cos(double{x}))));
+        if (worst_cos > 1e-6f)
+        {
+            pass = false;
+            std::printf("test failed!\ncos_approx is off by %g\n", worst_cos);
+        }
+
+        constexpr std::size_t num_cars = 19;  // two AVX2 blocks and a tail
+        EnvironmentInit env_init;
+        env_init.seed = 7;
+        env_init.use_seed = true;
+        MountainCarBatchEnv batch;
+        batch.env_init(env_init, num_cars);
+        batch.env_start();
+
+        std::vector<MountainCarEnvironment> cars(num_cars);
+        std::vector<State> states(num_cars);
+        for (std::size_t i=0; i < num_cars; ++i)
+        {
+            env_init.run = i;
+            cars[i].env_init(env_init);
+            states[i] = cars[i].env_start().state;
+        }
+
+        // Pump energy into each car, with some random actions
+        std::mt19937 action_gen(0);
+        std::uniform_int_distribution<Action> random_action(0, 2);
+        std::vector<Action> actions(num_cars);
+        float worst = 0;
+        unsigned int num_episodes = 0;
+        for (int step=0; step < 2000 && pass; ++step)
+        {
+            for (std::size_t i=0; i < num_cars; ++i)
+                actions[i] = (action_gen() % 10 == 0) ? random_action(action_gen) :
+                             (states[i].velocity >= 0) ? 2 : 0;
+            batch.env_step(actions.data());
+
+            for (std::size_t i=0; i < num_cars && pass; ++i)
+            {
+                Observation obs = cars[i].env_step(actions[i]);
+                if (obs.termination != batch.is_terminal(i) || obs.reward != batch.get_rewards()[i])
+                {
+                    pass = false;
+                    std::printf("test failed!\nstep %d car %zu: termination %d instead of %d\n",
+                            step, i, batch.is_terminal(i), obs.termination);
+                    break;
+                }
+
+                State state = batch.get_state(i);
+                if (obs.termination)
+                {
+                    ++num_episodes;
+                    obs = cars[i].env_start();
+                    if (state.position != obs.state.position || state.velocity != 0)
+                    {
+                        pass = false;
+                        std::printf("test failed!\nstep %d car %zu: started at %f instead of %f\n",
+                                step, i, state.position, obs.state.position);
+                    }
+                }
+                worst = std::max({worst, std::abs(state.position - obs.state.position),
+                                  std::abs(state.velocity - obs.state.velocity)});
+                states[i] = obs.state;
+            }
+        }
+        if (worst > 1e-3f || num_episodes < num_cars)
+        {
+            pass = false;
+            std::printf("test failed!\n%u episodes, states off by up to %g\n", num_episodes, worst);
+        }
+    }
+    std::printf("Mountain Car Batch Environment Test %s\n", pass ? "Passed" : "Failed");
+
+    // A result file holds its columns at 64 byte aligned offsets after the
+    // header, bit for bit, and the header names their dtypes and shapes
+    pass = true;
+    {
+        const std::string path = "mountain_car_test_results.bin";
+        std::vector<float> steps(3 * 5);
+        for (std::size_t i=0; i < steps.size(); ++i)
+            steps[i] = 0.5f * i - 1.0f;
+        std::vector<std::uint32_t> counts = {1, 2, 3, 4, 5, 6, 7};
+
+        ResultFile results;
+        results.set_config("num_runs", "2");
+        results.set_config("config_0", "a \"quoted\" value");
+        results.add_column("steps", {3, 5}, steps.data());
+        results.add_column("counts", {counts.size()}, counts.data());
+        results.write(path);
+
+        std::ifstream file(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+
+        std::uint32_t version = 0, header_size = 0;
+        if (bytes.size() >= 16)
+        {
+            std::memcpy(&version, bytes.data() + 8, 4);
+            std::memcpy(&header_size, bytes.data() + 12, 4);
+        }
+        const std::string header = bytes.substr(16, header_size);
+        if (bytes.compare(0, 8, "RLRESULT") != 0 || version != 1 || (16 + header_size) % 64 != 0 ||
+            header.find("\"config_0\": \"a \\\"quoted\\\" value\"") == std::string::npos ||
+            header.find("\"name\": \"steps\", \"dtype\": \"<f4\", \"shape\": [3, 5], \"offset\": 0}") == std::string::npos ||
+            header.find("\"name\": \"counts\", \"dtype\": \"<u4\", \"shape\": [7], \"offset\": 64}") == std::string::npos)
+        {
+            pass = false;
+            std::printf("test failed!\nunexpected header: %s\n", header.c_str());
+        }
+        else if (bytes.size() != 16 + header_size + 128 ||
+                 std::memcmp(bytes.data() + 16 + header_size, steps.data(), steps.size() * sizeof(float)) != 0 ||
+                 std::memcmp(bytes.data() + 16 + header_size + 64, counts.data(), counts.size() * 4) != 0)
+        {
+            pass = false;
+            std::printf("test failed!\ncolumns not stored at their offsets\n");
+        }
+        std::remove(path.c_str());
+    }
+    std::printf("Mountain Car Result File Test %s\n", pass ? "Passed" : "Failed");
+}
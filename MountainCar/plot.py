@@ -8,24 +8,14 @@ import sys
 import matplotlib.pyplot as plt
 import numpy as np
 
+# Local
+from result_file import read_results
 
-def openFile(filename):
-  try:
-    f = open(filename)
-  except IOError:
-    text = 'Couldn\'t open \"%s\" for reading\n' % filename
-    sys.stderr.write(text)
-    return None
-  except:
-    sys.stderr.write('unknown error\n')
-    return None
-
-  return f
 
 def main():
 
   if len(sys.argv) != 2:
-    print('usage: python plot.py <file>')
+    print('usage: python plot.py avg_steps.bin')
     exit(1)
         
   file = str(sys.argv[1])
@@ -37,39 +27,16 @@ def create_plot(filename):
 
     """
 
-    f = openFile(filename)
-    if not f:
-      return
-
-    lines = f.readlines()
-    f.close()
-
-    avg_steps = []
-    for line in lines:
-        cols = line.split(' ')
-        cols = cols[0:-1]
-        [val0, val1, val2] = [float(x.strip()) for x in cols]
-        avg_steps.append([val0, val1, val2])
-
-    alphas = [0.5]
-    agent_info_options = [{"num_tiles": 16, "num_tilings": 2, "alpha": 0.5},
-                          {"num_tiles": 4, "num_tilings": 32, "alpha": 0.5},
-                          {"num_tiles": 8, "num_tilings": 8, "alpha": 0.5}]
-    agent_info_options = [{"num_tiles": agent["num_tiles"],
-                           "num_tilings": agent["num_tilings"],
-                           "alpha": alpha} for agent in agent_info_options for alpha in alphas]
-
+    config, columns = read_results(filename)
+    avg_steps = columns["avg_steps"]
 
     plt.figure(figsize=(15, 10), dpi= 80, facecolor='w', edgecolor='k')
-    plt.plot(np.array(avg_steps))
+    plt.plot(np.transpose(avg_steps))
     plt.xlabel("Episode")
     plt.ylabel("Steps Per Episode")
     plt.yscale("linear")
     plt.ylim(0, 1000)
-    plt.legend(["num_tiles: {}, num_tilings: {}, alpha: {}".format(agent_info["num_tiles"],
-                                                               agent_info["num_tilings"],
-                                                               agent_info["alpha"])
-            for agent_info in agent_info_options])
+    plt.legend([config["config_%d" % row] for row in range(avg_steps.shape[0])])
     plt.grid(True)
     plt.savefig('fig1.pdf')
     plt.show()
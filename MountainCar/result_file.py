@@ -0,0 +1,39 @@
+"""Reads the binary result files the experiments write, see result_file.hpp."""
+
+# Standard library
+import json
+
+# Third-party libraries
+import numpy as np
+
+
+MAGIC = b'RLRESULT'
+PREFIX_SIZE = 16
+
+
+def read_results(filename):
+    """Map the columns of the result file ``filename`` into memory.
+
+    Returns the config of the experiment, a dict of strings, and a dict of
+    the columns, each a read-only ``numpy.memmap`` of its dtype and shape;
+    no data is read until it is used.
+    """
+    with open(filename, 'rb') as f:
+        prefix = f.read(PREFIX_SIZE)
+        if len(prefix) != PREFIX_SIZE or prefix[:8] != MAGIC:
+            raise ValueError('%s is not a result file' % filename)
+        version, header_size = np.frombuffer(prefix[8:], dtype='<u4')
+        if version != 1:
+            raise ValueError('%s has format version %d, not 1' % (filename, version))
+        header = json.loads(f.read(int(header_size)).decode('utf-8'))
+
+    data_start = PREFIX_SIZE + int(header_size)
+    columns = {}
+    for column in header['columns']:
+        shape = tuple(column['shape'])
+        if 0 in shape:
+            columns[column['name']] = np.empty(shape, dtype=column['dtype'])
+        else:
+            columns[column['name']] = np.memmap(filename, dtype=column['dtype'], mode='r',
+                                                offset=data_start + column['offset'], shape=shape)
+    return header['config'], columns
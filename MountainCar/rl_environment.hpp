@@ -7,6 +7,9 @@ namespace rl {
 namespace env {
 
 struct EnvironmentInit {
+    unsigned int seed{0};
+    bool use_seed{false};  // default to random seed
+    unsigned int run{0};   // each run of an experiment draws its own stream
 };
 
 class Environment {
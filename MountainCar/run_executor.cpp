@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "run_executor.hpp"
+
+namespace rl {
+
+RunExecutor::RunExecutor(EnvironmentFactory make_env, AgentFactory make_agent, const unsigned int num_threads)
+: make_env(std::move(make_env)), make_agent(std::move(make_agent)),
+  num_threads(num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+void RunExecutor::run(const unsigned int num_runs, const EnvironmentInit& env_params, const AgentInit& agent_params,
+                      const RunFunction& run_function) const
+{
+    // Threads take the next run as they finish one, so long and short runs
+    // even out
+    std::atomic<unsigned int> next_run{0};
+    std::vector<std::exception_ptr> errors(num_runs);
+
+    auto worker = [&]()
+    {
+        for (unsigned int run = next_run++; run < num_runs; run = next_run++)
+        {
+            try
+            {
+                RL rl(make_env(), make_agent());
+                EnvironmentInit run_env_params = env_params;
+                AgentInit run_agent_params = agent_params;
+                run_env_params.run = run;
+                run_agent_params.run = run;
+                rl.rl_init(run_env_params, run_agent_params);
+                run_function(rl, run);
+            }
+            catch (...)
+            {
+                errors[run] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < std::min(num_threads, num_runs); ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+} // rl
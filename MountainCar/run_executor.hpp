@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include "rl.hpp"
+
+namespace rl {
+
+/* Runs the independent runs of an experiment on a pool of threads. Each run
+ * gets an environment and an agent of its own from the factories, so nothing
+ * is shared between threads but the function given to run(), e.g.
+ *
+ *     RunExecutor executor([]() { return std::make_shared<MyEnvironment>(); },
+ *                          []() { return std::make_shared<MyAgent>(); });
+ *     executor.run(num_runs, env_params, agent_params,
+ *                  [&](RL& rl, const unsigned int run) { returns[run] = ...; });
+ *
+ * Run r is initialized with the given parameters and run = r, so it draws
+ * the same streams on any number of threads. The function is called on a
+ * worker thread; it should write its results to slots of its own run, which
+ * need no locking.
+ */
+class RunExecutor {
+public:
+    using EnvironmentFactory = std::function<std::shared_ptr<Environment>()>;
+    using AgentFactory = std::function<std::shared_ptr<Agent>()>;
+    using RunFunction = std::function<void(RL& rl, const unsigned int run)>;
+
+    // num_threads = 0 uses one thread per hardware thread
+    RunExecutor(EnvironmentFactory make_env, AgentFactory make_agent, const unsigned int num_threads = 0);
+
+    // Runs 0 to num_runs - 1 and returns when all are done; if any runs
+    // threw, the exception of the lowest numbered one is rethrown here, which
+    // need not be the first thrown
+    void run(const unsigned int num_runs, const EnvironmentInit& env_params, const AgentInit& agent_params,
+             const RunFunction& run_function) const;
+
+    unsigned int get_num_threads() const { return num_threads; }
+
+private:
+    EnvironmentFactory make_env;
+    AgentFactory make_agent;
+    unsigned int num_threads;
+};
+
+} // rl
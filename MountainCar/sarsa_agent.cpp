@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include "sarsa_agent.hpp"
 
@@ -12,7 +15,8 @@ using range = boost::multi_array_types::index_range;
 /* Setup for the agent when the RL environment starts.
  *     AgentInit is a structured class of parameters used to initialize the agent.
  */
-void SarsaAgent::agent_init(const AgentInit& params)
+template <class S, class F>
+void SarsaAgentT<S, F>::agent_init(const AgentInit& params)
 {
     num_actions = params.num_actions;
     num_states = params.num_states;
@@ -21,6 +25,9 @@ void SarsaAgent::agent_init(const AgentInit& params)
     discount = params.discount;
     seed = params.seed;
 
+    if (num_actions > max_actions)
+        throw(std::out_of_range("SarsaAgent: too many actions"));
+
     // Additional parameters for tile coding
     num_tilings = params.num_tilings;
     num_tiles = params.num_tiles;
@@ -29,9 +36,17 @@ void SarsaAgent::agent_init(const AgentInit& params)
     prev_state = {0, 0};
     prev_action = 0;
 
-    gen = std::mt19937(seed);
-    rand_real = std::uniform_real_distribution<>(0, 1);
-    rand_int = std::uniform_int_distribution<>(0, num_actions-1);
+    // The cache follows one-step updates only. Adding each update to the
+    // cached values rounds differently from summing the updated weights
+    // again, so the cache is an approximation: it drifts from the sums by
+    // the rounding of the steps spent on the same tiles, and may break a
+    // near tie differently. Weights rounded on storage, e.g. bfloat16, would
+    // widen the gap, so they always sum afresh
+    cache_action_values = params.cache_action_values && params.lambda == 0 &&
+                          std::is_same<S, F>::value;
+    cached_q_valid = false;
+
+    gen = rng::make_engine(seed, params.run, rng::agent_stream);
 
     // Create an array for action-value estimates and initialize it to zero.
     Float2D::extent_gen extents;
@@ -40,33 +55,45 @@ void SarsaAgent::agent_init(const AgentInit& params)
     // Using linear function approximation; need a set of weights for each action
     // The weights essential replace the q_values which are simply weights^T * x(s, a)
     // where the feature vector, x(s,a), is just the one-hot vector of active tiles
-    weights.resize(extents[num_actions][index_hash_table_size]);
-
-    using index = Float2D::index;
-
-    for(index i = 0; i < num_actions; ++i)
-      for(index j = 0; j < index_hash_table_size; ++j)
-        weights[i][j] = 0.0;
-
-    tc.initialize(index_hash_table_size, num_tilings, num_tiles);
+    weights.resize(num_actions, index_hash_table_size, params.weight_layout);
+
+    lambda = params.lambda;
+    traces.resize(index_hash_table_size, weights.get_padded_actions(), params.trace_type,
+                  params.trace_threshold);
+
+    tc.initialize(index_hash_table_size, num_tilings, num_tiles, params.overflow_policy,
+                  params.tile_indexing);
+    if (params.shared_index_table)
+    {
+        if (params.shared_index_table->get_capacity() > index_hash_table_size)
+            throw(std::out_of_range("SarsaAgent: shared index table larger than the weights"));
+        tc.share_table(params.shared_index_table);
+    }
 }
 
 /* The first method called after the RL environment starts.
  *     Input: the state from the environmnent's env_start method.
  *     Returns: the first action taken by the agent.
  */
-Action SarsaAgent::agent_start(const State state)
+template <class S, class F>
+Action SarsaAgentT<S, F>::agent_start(const State state)
 {
     Action action{0};
-    float q_value{0};
-    auto tiles = tc.get_tiles(state.position, state.velocity);
+    F q_value{0};
+    auto& tiles = tile_buffers.next();
+    tc.get_tiles(state.position, state.velocity, tiles);
 
     // Select epsilon greedy action
-    std::tie(action, q_value) = select_action(tiles);
+    cached_q_valid = false;
+    traces.clear();
+    if (cache_action_values)
+        std::tie(action, q_value) = select_action(action_values(tiles));
+    else
+        std::tie(action, q_value) = select_action(weights, tiles);
 
     prev_state = state;
     prev_action = action;
-    prev_tiles = tiles;
+    tile_buffers.swap();
     prev_q_value = q_value;
 
     return action;
@@ -78,23 +105,35 @@ Action SarsaAgent::agent_start(const State state)
  *            state from the environment's last step
  *     Returns: the action the agent is taking
  */
-Action SarsaAgent::agent_step(const float reward, const State state)
+template <class S, class F>
+Action SarsaAgentT<S, F>::agent_step(const float reward, const State state)
 {
     Action action{0};
-    float q_value{0};
-    auto tiles = tc.get_tiles(state.position, state.velocity);
+    F q_value{0};
+    auto& tiles = tile_buffers.next();
+    tc.get_tiles(state.position, state.velocity, tiles);
 
     // Choose action using epsilon greedy
-    std::tie(action, q_value) = select_action(tiles);
+    if (cache_action_values)
+        std::tie(action, q_value) = select_action(action_values(tiles));
+    else
+        std::tie(action, q_value) = select_action(weights, tiles);
 
-    float update_target = reward + discount * q_value - prev_q_value;
+    F update_target = reward + discount * q_value - prev_q_value;
 
-    for (std::size_t j=0; j < prev_tiles.size(); ++j)
-        weights[prev_action][prev_tiles[j]] += step_size * update_target;
+    const auto& prev_tiles = tile_buffers.prev();
+    if (lambda > 0)
+        update_traced_weights(update_target);
+    else
+        for (std::size_t j=0; j < prev_tiles.size(); ++j)
+            weights[prev_action][prev_tiles[j]] += step_size * update_target;
+
+    if (cache_action_values)
+        update_cached_q(tiles, prev_tiles, step_size * update_target);
 
     prev_state = state;
     prev_action = action;
-    prev_tiles = tiles;
+    tile_buffers.swap();
     prev_q_value = q_value;
 
     return action;
@@ -103,19 +142,94 @@ Action SarsaAgent::agent_step(const float reward, const State state)
 /* Runs when the agent terminates.
  *     Input: reward the agent received for reaching the terminal state
  */
-void SarsaAgent::agent_end(const float reward)
+template <class S, class F>
+void SarsaAgentT<S, F>::agent_end(const float reward)
 {
     // Same action-value update as in agent_step but with expected_return = 0
-    float update_target = reward - prev_q_value;
+    F update_target = reward - prev_q_value;
+
+    const auto& prev_tiles = tile_buffers.prev();
+    if (lambda > 0)
+    {
+        update_traced_weights(update_target);
+        traces.clear();
+    }
+    else
+        for (std::size_t j=0; j < prev_tiles.size(); ++j)
+            weights[prev_action][prev_tiles[j]] += step_size * update_target;
+
+    cached_q_valid = false;
+}
+
+/* SARSA(lambda) with binary features: refreshes the traces of the previous
+ * tiles for the previous action, moves every traced weight by
+ * step_size * delta * z, then decays the traces by discount * lambda.
+ * Replacing traces also clear the traces of the other actions of those
+ * tiles.
+ */
+template <class S, class F>
+void SarsaAgentT<S, F>::update_traced_weights(const F delta)
+{
+    std::array<F, max_actions> gradient{};
+    gradient[prev_action] = 1;
 
+    const auto& prev_tiles = tile_buffers.prev();
     for (std::size_t j=0; j < prev_tiles.size(); ++j)
-        weights[prev_action][prev_tiles[j]] += step_size * update_target;
+        traces.add(prev_tiles[j], gradient.data());
+
+    for (std::size_t i=0; i < traces.size(); ++i)
+        weights.add(traces.key(i), traces.trace(i), step_size * delta);
+
+    traces.decay(discount * lambda);
 }
 
-void SarsaAgent::agent_cleanup() { }
+/* Action values of tiles, from the cache when tiles are the previous tiles */
+template <class S, class F>
+const F* SarsaAgentT<S, F>::action_values(const TileSpan tiles)
+{
+    const auto& prev_tiles = tile_buffers.prev();
+    if (!cached_q_valid ||
+        !std::equal(tiles.begin(), tiles.end(), prev_tiles.begin(), prev_tiles.end()))
+    {
+        cached_q.fill(0);
+        weights.add_action_values(tiles, cached_q.data());
+    }
+    return cached_q.data();
+}
 
-std::string SarsaAgent::agent_message(const std::string& message)
+/* Carries the update of weights[prev_action][prev_tiles] by delta into the
+ * cached action values of tiles. Tiling k holds tile k of every state, so
+ * only tiles in the same position can be the same.
+ */
+template <class S, class F>
+void SarsaAgentT<S, F>::update_cached_q(const TileSpan tiles, const TileSpan prev_tiles, const F delta)
 {
-    (void)message;
-    return std::string("");
+    std::size_t shared_tiles = 0;
+    for (std::size_t k=0; k < tiles.size(); ++k)
+        shared_tiles += (tiles[k] == prev_tiles[k]);
+
+    cached_q[prev_action] += shared_tiles * delta;
+    cached_q_valid = tc.get_collision_count() == 0;
 }
+
+template <class S, class F>
+void SarsaAgentT<S, F>::agent_cleanup() { }
+
+template <class S, class F>
+std::string SarsaAgentT<S, F>::agent_message(const std::string& message)
+{
+    if (message == "get collisions")
+        return std::to_string(tc.get_collision_count());
+    else if (message.compare(0, 17, "save index table ") == 0)
+    {
+        tc.save_table(message.substr(17));
+        return std::string("saved");
+    }
+    else
+        return std::string("");
+}
+
+template class SarsaAgentT<float, float>;
+template class SarsaAgentT<float, double>;
+template class SarsaAgentT<double, double>;
+template class SarsaAgentT<bfloat16, float>;
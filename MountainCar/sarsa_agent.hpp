@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdio>
 #include <vector>
 #include "rl_agent.hpp"
@@ -9,11 +10,13 @@ using namespace rl;
 using namespace agent;
 using namespace mctc;
 
-class SarsaAgent : public Agent
+// SARSA with weights stored as S and updated in F, see ActionWeights
+template <class S, class F>
+class SarsaAgentT : public Agent
 {
 public:
-    SarsaAgent() : Agent() { };
-    ~SarsaAgent() {};
+    SarsaAgentT() : Agent() { };
+    ~SarsaAgentT() {};
 
     virtual void agent_init(const AgentInit& params) override;
     virtual Action agent_start(const State state) override;
@@ -28,6 +31,26 @@ protected:
     unsigned int num_tiles{0};
     unsigned int index_hash_table_size{0};
     MountainCarTileCoder tc;
-    std::vector<uint32_t> prev_tiles;
-    float prev_q_value{0};
+    TileBuffers tile_buffers;  // active tiles of the previous and next state
+    ActionWeights<S, F> weights;
+    F prev_q_value{0};
+
+    // Action values of the previous tiles under the current weights, up to
+    // rounding. Valid while no two keys have shared an index, so the tilings
+    // of a state never share weights and a weight update moves one action
+    // value by the step times the number of tiles it touched.
+    bool cache_action_values{false};
+    bool cached_q_valid{false};
+    std::array<F, max_actions> cached_q{};
+
+    // SARSA(lambda) traces of the previous state-action pairs, one value
+    // per action for each tile
+    float lambda{0};
+    EligibilityTraces<F> traces;
+    void update_traced_weights(const F delta);
+
+    const F* action_values(const TileSpan tiles);
+    void update_cached_q(const TileSpan tiles, const TileSpan prev_tiles, const F delta);
 };
+
+using SarsaAgent = SarsaAgentT<WeightStorage, WeightMath>;
@@ -1,49 +1,1336 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
-#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
-#include "tuple_hash.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace tc {
 
-// Simplified two coordinate tile coder
-class TileCoder
+// What the index hash table does when a new key arrives and it is full
+//   Throw    - throw std::out_of_range
+//   Fold     - map the key to hash(key) % capacity, sharing an existing index
+//   HashOnly - keep no table at all; every key maps to hash(key) % capacity
+enum class OverflowPolicy { Throw, Fold, HashOnly };
+
+// How a task tile coder turns tile coordinates into weight indices
+//   Hashed - TileCoder, indices handed out by an index hash table
+//   Dense  - DenseTileCoder, indices computed directly from the coordinates
+enum class TileIndexing { Hashed, Dense };
+
+// Active tile indices for one state, stored inline so that tile coding a
+// state needs no heap allocation.
+class Tiles
+{
+public:
+    static constexpr std::size_t max_tilings = 64;
+
+    void resize(const std::size_t n)
+    {
+        if (n > max_tilings)
+            throw(std::out_of_range("Tiles: more than max_tilings tilings"));
+        count = n;
+    }
+
+    std::size_t size() const { return count; }
+    std::uint32_t* data() { return indices.data(); }
+    const std::uint32_t* data() const { return indices.data(); }
+    std::uint32_t& operator[](const std::size_t i) { return indices[i]; }
+    const std::uint32_t& operator[](const std::size_t i) const { return indices[i]; }
+    std::uint32_t* begin() { return indices.data(); }
+    std::uint32_t* end() { return indices.data() + count; }
+    const std::uint32_t* begin() const { return indices.data(); }
+    const std::uint32_t* end() const { return indices.data() + count; }
+
+private:
+    std::array<std::uint32_t, max_tilings> indices;
+    std::size_t count{0};
+};
+
+// Tile buffers for the previous and the next state. The agent fills next(),
+// updates using prev() and then swap()s, so the previous tiles are never copied.
+class TileBuffers
+{
+public:
+    Tiles& next() { return buffers[1 - prev_idx]; }
+    Tiles& prev() { return buffers[prev_idx]; }
+    const Tiles& prev() const { return buffers[prev_idx]; }
+    void swap() { prev_idx = 1 - prev_idx; }
+
+private:
+    std::array<Tiles, 2> buffers;
+    std::size_t prev_idx{0};
+};
+
+// Read only view of active tiles held in a Tiles buffer or a std::vector
+class TileSpan
+{
+public:
+    TileSpan(const Tiles& tiles) : ptr(tiles.data()), count(tiles.size()) { }
+    TileSpan(const std::vector<std::uint32_t>& tiles) : ptr(tiles.data()), count(tiles.size()) { }
+
+    std::size_t size() const { return count; }
+    const std::uint32_t& operator[](const std::size_t i) const { return ptr[i]; }
+    const std::uint32_t* begin() const { return ptr; }
+    const std::uint32_t* end() const { return ptr + count; }
+
+private:
+    const std::uint32_t* ptr;
+    std::size_t count;
+};
+
+// Unsigned 32-bit division by a divisor fixed in advance, done with a
+// multiply and two shifts (Granlund and Montgomery, "Division by invariant
+// integers using multiplication"). Exact for every 32-bit numerator.
+class Divider
+{
+public:
+    Divider(const std::uint32_t d = 1) : divisor(d)
+    {
+        if (d == 0)
+            throw(std::out_of_range("Divider: division by zero"));
+
+        // l = ceil(log2(d)), m = 2^32 * (2^l - d) / d + 1 fits in 32 bits
+        std::uint32_t l = 0;
+        while ((std::uint64_t(1) << l) < d)
+            ++l;
+        multiplier = static_cast<std::uint32_t>(
+                ((std::uint64_t(1) << 32) * ((std::uint64_t(1) << l) - d)) / d + 1);
+        shift1 = std::min(l, 1u);
+        shift2 = (l > 0) ? l - 1 : 0;
+    }
+
+    std::uint32_t get_divisor() const { return divisor; }
+
+    std::uint32_t divide(const std::uint32_t n) const
+    {
+        std::uint32_t t = static_cast<std::uint32_t>((std::uint64_t(multiplier) * n) >> 32);
+        return (t + ((n - t) >> shift1)) >> shift2;
+    }
+
+    std::uint32_t modulo(const std::uint32_t n) const { return n - divide(n) * divisor; }
+
+#ifdef __AVX2__
+    __m256i divide(const __m256i n) const
+    {
+        // High halves of the 32 x 32 bit products, even and odd lanes apart
+        const __m256i m = _mm256_set1_epi32(static_cast<int>(multiplier));
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, m), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(n, 32), m);
+        __m256i t = _mm256_blend_epi32(even, odd, 0xAA);
+
+        __m256i q = _mm256_srl_epi32(_mm256_sub_epi32(n, t), _mm_cvtsi32_si128(shift1));
+        return _mm256_srl_epi32(_mm256_add_epi32(t, q), _mm_cvtsi32_si128(shift2));
+    }
+
+    __m256i modulo(const __m256i n) const
+    {
+        const __m256i d = _mm256_set1_epi32(static_cast<int>(divisor));
+        return _mm256_sub_epi32(n, _mm256_mullo_epi32(divide(n), d));
+    }
+#endif
+
+private:
+    std::uint32_t divisor;
+    std::uint32_t multiplier;
+    std::uint32_t shift1;
+    std::uint32_t shift2;
+};
+
+/* Coordinates of the quantized float q along one dimension in tilings
+ * first, ..., first + count - 1, as in tiles3,
+ *     coords[i] = (q + tiling * disp) / num_tilings
+ * where nt divides by num_tilings. Arithmetic is unsigned 32-bit throughout,
+ * so a negative q wraps exactly as it does in the scalar key computation.
+ */
+inline void tiling_coords(const std::uint32_t q, const std::uint32_t disp,
+                          const std::uint32_t first, const std::uint32_t count,
+                          const Divider& nt, std::uint32_t* coords)
+{
+    std::uint32_t i = 0;
+#ifdef __AVX2__
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i vq = _mm256_set1_epi32(static_cast<int>(q));
+    const __m256i vdisp = _mm256_set1_epi32(static_cast<int>(disp));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i tiling = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first + i)), lanes);
+        __m256i n = _mm256_add_epi32(vq, _mm256_mullo_epi32(tiling, vdisp));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(coords + i), nt.divide(n));
+    }
+#endif
+    for (; i < count; ++i)
+        coords[i] = nt.divide(q + (first + i) * disp);
+}
+
+/* As tiling_coords for tileswrap, where the displacement is taken modulo
+ * num_tilings and, given a wrap divider, the coordinate modulo the wrap width,
+ *     coords[i] = ((q + (tiling * disp) % num_tilings) / num_tilings) % wrap_width
+ */
+inline void tiling_coords_wrap(const std::uint32_t q, const std::uint32_t disp,
+                               const std::uint32_t first, const std::uint32_t count,
+                               const Divider& nt, const Divider* wrap, std::uint32_t* coords)
+{
+    std::uint32_t i = 0;
+#ifdef __AVX2__
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i vq = _mm256_set1_epi32(static_cast<int>(q));
+    const __m256i vdisp = _mm256_set1_epi32(static_cast<int>(disp));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i tiling = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first + i)), lanes);
+        __m256i offset = nt.modulo(_mm256_mullo_epi32(tiling, vdisp));
+        __m256i c = nt.divide(_mm256_add_epi32(vq, offset));
+        if (wrap)
+            c = wrap->modulo(c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(coords + i), c);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        std::uint32_t c = nt.divide(q + nt.modulo((first + i) * disp));
+        coords[i] = wrap ? wrap->modulo(c) : c;
+    }
+}
+
+/* Coordinates along one dimension of count states in a single tiling, for
+ * coding many states at once,
+ *     coords[i] = ((q[i] + offset) / num_tilings) % wrap_width
+ * where offset is the tiling's displacement (taken modulo num_tilings by
+ * tileswrap) and the wrap is skipped when there is no wrap divider.
+ */
+inline void state_coords(const std::uint32_t* q, const std::size_t count, const std::uint32_t offset,
+                         const Divider& nt, const Divider* wrap, std::uint32_t* coords)
+{
+    std::size_t i = 0;
+#ifdef __AVX2__
+    const __m256i voffset = _mm256_set1_epi32(static_cast<int>(offset));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + i));
+        __m256i c = nt.divide(_mm256_add_epi32(n, voffset));
+        if (wrap)
+            c = wrap->modulo(c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(coords + i), c);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        std::uint32_t c = nt.divide(q[i] + offset);
+        coords[i] = wrap ? wrap->modulo(c) : c;
+    }
+}
+
+// Fixed capacity, open addressing index hash table (IHT). Maps tile
+// coordinates to indices in [0, capacity), handed out in insertion order.
+// Slots are allocated once in set_capacity(); a lookup probes linearly from
+// the home slot and inserts into the first empty slot it meets, so each call
+// is a single pass over the table.
+template <std::size_t KeyWords>
+class IndexHashTable
 {
 public:
-    TileCoder(const std::size_t capacity);
-    TileCoder();
-    virtual ~TileCoder();
+    // (tiling + 1, coordinates...) packed as 32-bit words; a zero first word
+    // marks an empty slot.
+    using KeyType = std::array<std::uint32_t, KeyWords>;
+
+    IndexHashTable() { set_capacity(0); }
+    explicit IndexHashTable(const std::size_t capacity) { set_capacity(capacity); }
 
-    std::vector<std::uint32_t> get_tiles(const std::uint32_t num_tilings, const std::vector<float>& floats);
+    // Returns the index of key k, assigning the next free index if k is new.
+    // Once the table is full new keys are handled according to the overflow
+    // policy.
+    std::uint32_t get_index(const KeyType& k);
+    // Looks up n keys in order, exactly as n calls to get_index would, but
+    // hashes a batch of keys and prefetches their home slots before probing.
+    void get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices);
+
+    // Keeps the keys held, so throws std::invalid_argument if there are more
+    // than capacity of them; clear() the table first to shrink it below that
     void set_capacity(const std::size_t capacity);
-    bool is_full() { return get_size() == capacity; }
-    std::size_t get_size();
+    void set_overflow_policy(const OverflowPolicy policy);
+    std::size_t get_capacity() const { return capacity; }
+    std::size_t get_size() const { return size; }
+    bool is_full() const { return size >= capacity; }
+    OverflowPolicy get_overflow_policy() const { return policy; }
+    // Number of lookups that were given an index already owned by another key
+    std::size_t get_collision_count() const { return collision_count; }
+    void clear();
+
+    // Write the table to a file that MappedIndexHashTable can open
+    void save(const std::string& path) const;
+
+    // Folds the key words together and finishes with the murmur3 64-bit mixer
+    static std::uint64_t hash(const KeyType& k)
+    {
+        std::uint64_t h = 0;
+        for (const auto w : k)
+            h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
 
 private:
-    using KeyType = std::tuple<int, int, int>;
-    using KeyHash = std::hash<KeyType>;
+    std::uint32_t probe(const KeyType& k, const std::uint64_t h);
+    std::uint32_t get_hashed_index(const KeyType& k);
+
+    struct Slot
+    {
+        KeyType key{};
+        std::uint32_t index{0};
+    };
+
+    std::vector<Slot> slots;
+    std::size_t mask{0};
+    std::size_t capacity{0};
+    std::size_t size{0};
+    OverflowPolicy policy{OverflowPolicy::Throw};
+    std::size_t collision_count{0};
+
+    // HashOnly mode keeps a 32-bit fingerprint of the last key seen at each
+    // index instead of the keys themselves, just enough to count collisions.
+    std::vector<std::uint32_t> fingerprints;
+};
+
+// Index table that several tile coders look keys up in, a batch at a time
+template <std::size_t KeyWords>
+class SharedIndexTable
+{
+public:
+    using KeyType = std::array<std::uint32_t, KeyWords>;
+
+    virtual ~SharedIndexTable() { }
+
+    virtual void get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices) = 0;
+    virtual std::size_t get_capacity() const = 0;
+    virtual std::size_t get_size() const = 0;
+    virtual std::size_t get_collision_count() const = 0;
+    bool is_full() const { return get_size() >= get_capacity(); }
+};
+
+// Index hash table that tile coders on different threads can share, so runs
+// with the same tiling configuration build one mapping between them. Lookups
+// never lock: a new key claims an empty slot by a compare and swap on its
+// state word, writes the key and publishes the slot with its index; a lookup
+// that meets a slot being written waits only for that one store.
+//
+// Indices are handed out in arrival order, so which index a key gets depends
+// on how the threads interleave, but an agent's learning does not: its active
+// tiles, and so its action values, are the same whatever their indices as
+// long as no two keys share one. The table therefore never folds keys
+// together; only OverflowPolicy::Throw is accepted, and a lookup of a new key
+// in a full or frozen table throws. Under Fold which keys collided would
+// change from run to run.
+template <std::size_t KeyWords>
+class ConcurrentIndexHashTable : public SharedIndexTable<KeyWords>
+{
+public:
+    using KeyType = std::array<std::uint32_t, KeyWords>;
+
+    // The Throw overflow policy only; the slot array is sized once here
+    explicit ConcurrentIndexHashTable(const std::size_t capacity,
+                                      const OverflowPolicy policy = OverflowPolicy::Throw);
 
     std::uint32_t get_index(const KeyType& k);
-    //std::uint32_t hash_coords;
-    std::size_t capacity;
+    void get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices) override;
+
+    // Stop inserting new keys, e.g. once a warm up run has visited the state space
+    void freeze() { frozen.store(true, std::memory_order_release); }
+    bool is_frozen() const { return frozen.load(std::memory_order_acquire); }
+
+    // Write the published keys to a file that MappedIndexHashTable can open;
+    // keys being inserted meanwhile may or may not be included
+    void save(const std::string& path) const;
+
+    std::size_t get_capacity() const override { return capacity; }
+    std::size_t get_size() const override { return std::min(size.load(std::memory_order_relaxed), capacity); }
+    OverflowPolicy get_overflow_policy() const { return policy; }
+    std::size_t get_collision_count() const override { return collision_count.load(std::memory_order_relaxed); }
+
+private:
+    // Slot states; a published slot holds published + its index, a rejected
+    // one a key that came after the table was full
+    static constexpr std::uint32_t empty = 0;
+    static constexpr std::uint32_t claimed = 1;
+    static constexpr std::uint32_t rejected = 2;
+    static constexpr std::uint32_t published = 3;
+
+    struct Slot
+    {
+        std::atomic<std::uint32_t> state{empty};
+        KeyType key{};
+    };
+
+    std::uint32_t probe(const KeyType& k, const std::uint64_t h);
+    std::uint32_t overflow(const std::uint64_t h);
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask{0};
+    std::size_t capacity{0};
+    OverflowPolicy policy{OverflowPolicy::Throw};
+    std::atomic<std::size_t> size{0};
+    std::atomic<std::size_t> collision_count{0};
+    std::atomic<bool> frozen{false};
+};
+
+// Memory mapping of a whole file, read only and shared with other processes
+struct MappedFile
+{
+    const void* data{nullptr};
     std::size_t size{0};
-    unsigned int overflow_count{0};
+};
+
+// Defined in tc.cpp
+MappedFile map_file(const std::string& path);
+void unmap_file(MappedFile& file);
+void write_file(const std::string& path, const std::vector<char>& contents);
+
+// Read only index hash table memory mapped from a file written by save(),
+// for warm starting agents with the tile to index mapping of an earlier run.
+// Keys in the file keep their indices and are never inserted again; new keys
+// are handled by the overflow policy as if the table were full. Processes
+// mapping the same file share its pages.
+//
+// The file is a header followed by the open addressing slot array, probed
+// in place, in native byte order:
+//     magic, key words, capacity, size, number of slots,
+//     slots of (key words, index), a zero first key word marking an empty slot
+template <std::size_t KeyWords>
+class MappedIndexHashTable : public SharedIndexTable<KeyWords>
+{
+public:
+    using KeyType = std::array<std::uint32_t, KeyWords>;
+
+    // Throw and Fold overflow policies only
+    explicit MappedIndexHashTable(const std::string& path,
+                                  const OverflowPolicy policy = OverflowPolicy::Throw);
+    ~MappedIndexHashTable() override { unmap_file(file); }
+
+    MappedIndexHashTable(const MappedIndexHashTable&) = delete;
+    MappedIndexHashTable& operator=(const MappedIndexHashTable&) = delete;
+
+    std::uint32_t get_index(const KeyType& k) const;
+    void get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices) override;
 
-    struct KeyEqual : public std::binary_function<KeyType, KeyType, bool>
+    std::size_t get_capacity() const override { return header->capacity; }
+    std::size_t get_size() const override { return header->size; }
+    OverflowPolicy get_overflow_policy() const { return policy; }
+    std::size_t get_collision_count() const override { return collision_count.load(std::memory_order_relaxed); }
+
+    // Write (key, index) entries of a table with the given capacity to path
+    using Entry = std::pair<KeyType, std::uint32_t>;
+    static void write(const std::string& path, const std::size_t capacity, const std::vector<Entry>& entries);
+
+private:
+    static constexpr std::uint64_t magic = 0x31544849434354ULL;  // "TCCIHT1"
+
+    struct Header
     {
-        bool operator()(const KeyType& v1, const KeyType& v2) const
-        {
-            return(
-                       std::get<0>(v1) == std::get<0>(v2) &&
-                       std::get<1>(v1) == std::get<1>(v2) &&
-                       std::get<2>(v1) == std::get<2>(v2)
-                  );
-        }
+        std::uint64_t magic;
+        std::uint64_t key_words;
+        std::uint64_t capacity;
+        std::uint64_t size;
+        std::uint64_t num_slots;
     };
 
-    std::unordered_map<KeyType, std::size_t, KeyHash, KeyEqual> iht;
+    struct Slot
+    {
+        KeyType key;
+        std::uint32_t index;
+    };
+
+    std::uint32_t overflow(const std::uint64_t h) const;
+
+    MappedFile file;
+    const Header* header{nullptr};
+    const Slot* slots{nullptr};
+    std::size_t mask{0};
+    OverflowPolicy policy{OverflowPolicy::Throw};
+    mutable std::atomic<std::size_t> collision_count{0};
 };
 
+// Tile coder over Dims floats, following Sutton's tiles3. Each tiling is
+// displaced from the previous one by the asymmetric vector (1, 3, 5, ...)
+// in units of 1/num_tilings of a tile. The coordinates of all tilings are
+// computed a dimension at a time by tiling_coords, then looked up together.
+template <std::size_t Dims>
+class TileCoder
+{
+public:
+    using Floats = std::array<float, Dims>;
+    using WrapWidths = std::array<std::uint32_t, Dims>;
+    using Table = IndexHashTable<Dims + 1>;
+    using KeyType = typename Table::KeyType;
+
+    TileCoder(const std::size_t capacity) : iht(capacity) { }
+    TileCoder() { }
+    virtual ~TileCoder() { }
+
+    std::vector<std::uint32_t> get_tiles(const std::uint32_t num_tilings, const Floats& floats);
+    void get_tiles(const std::uint32_t num_tilings, const Floats& floats, Tiles& tiles);
+
+    // wrap_widths[d] > 0 wraps dimension d around after that many tiles
+    std::vector<std::uint32_t> get_tileswrap(const std::uint32_t num_tilings, const Floats& floats, const WrapWidths& wrap_widths);
+    void get_tileswrap(const std::uint32_t num_tilings, const Floats& floats, const WrapWidths& wrap_widths, Tiles& tiles);
+
+    // Write num_tilings indices to tiles
+    void get_tiles(const std::uint32_t num_tilings, const Floats& floats, std::uint32_t* tiles);
+    void get_tileswrap(const std::uint32_t num_tilings, const Floats& floats, const WrapWidths& wrap_widths, std::uint32_t* tiles);
+
+    // Structure of arrays input for n states, floats[d][i] being dimension d
+    // of state i. Writes an n x num_tilings row major matrix of indices to
+    // tiles, the same indices n single state calls would give, in order.
+    using FloatArrays = std::array<const float*, Dims>;
+    void get_tiles_batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+                         const std::size_t n, std::uint32_t* tiles);
+    void get_tileswrap_batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+                             const WrapWidths& wrap_widths, const std::size_t n, std::uint32_t* tiles);
+
+    // Look tiles up in a table shared with other coders instead of our own;
+    // nullptr goes back to the coder's own table
+    using SharedTable = SharedIndexTable<Dims + 1>;
+    void share_table(std::shared_ptr<SharedTable> table) { shared = std::move(table); }
+
+    // These apply to the coder's own table
+    void set_capacity(const std::size_t capacity) { iht.set_capacity(capacity); }
+    void set_overflow_policy(const OverflowPolicy policy) { iht.set_overflow_policy(policy); }
+    void clear() { iht.clear(); }
+    void save_table(const std::string& path) const { iht.save(path); }
+
+    bool is_full() { return shared ? shared->is_full() : iht.is_full(); }
+    std::size_t get_size() { return shared ? shared->get_size() : iht.get_size(); }
+    std::size_t get_collision_count() const
+    {
+        return shared ? shared->get_collision_count() : iht.get_collision_count();
+    }
+
+private:
+    using Ints = std::array<int, Dims>;
+
+    // Tilings are coded in blocks of this many
+    static constexpr std::uint32_t block_size = Tiles::max_tilings;
+    using Coords = std::array<std::array<std::uint32_t, block_size>, Dims>;
+
+    void lookup(const std::uint32_t first, const std::uint32_t count,
+                const Coords& coords, std::uint32_t* tiles);
+
+    // Keys looked up together when coding a batch of states
+    static constexpr std::size_t batch_keys = 256;
+
+    void batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+               const WrapWidths* wrap_widths, const std::size_t n, std::uint32_t* tiles);
+
+    static constexpr std::uint32_t displacement(const std::size_t d)
+    {
+        return static_cast<std::uint32_t>(2 * d + 1);
+    }
+
+    static Ints quantize(const std::uint32_t num_tilings, const Floats& floats)
+    {
+        Ints qfloats;
+        for (std::size_t d = 0; d < Dims; ++d)
+            qfloats[d] = static_cast<int>(std::floor(floats[d] * num_tilings));
+        return qfloats;
+    }
+
+    // Reciprocals of the most recent num_tilings and wrap widths
+    const Divider& tilings_divider(const std::uint32_t num_tilings)
+    {
+        if (nt_divider.get_divisor() != num_tilings)
+            nt_divider = Divider(num_tilings);
+        return nt_divider;
+    }
+
+    const Divider* wrap_divider(const std::size_t d, const std::uint32_t width)
+    {
+        if (width == 0)
+            return nullptr;
+        if (wrap_dividers[d].get_divisor() != width)
+            wrap_dividers[d] = Divider(width);
+        return &wrap_dividers[d];
+    }
+
+    // Keys go through the shared table if there is one
+    void get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices)
+    {
+        if (shared)
+            shared->get_indices(keys, n, indices);
+        else
+            iht.get_indices(keys, n, indices);
+    }
+
+    Table iht;
+    std::shared_ptr<SharedTable> shared;
+    Divider nt_divider;
+    std::array<Divider, Dims> wrap_dividers;
+};
+
+// Tile coder over a bounded box [0, num_tiles[0]] x [0, num_tiles[1]] x ...
+// of scaled floats, plus one tile of slack below zero for floats that round
+// to just under the lower bound. Produces the same tiles as TileCoder, but every tile of
+// every tiling gets a fixed index computed from its coordinates,
+//     tiling * stride + c[0] * extents[1] * ... + ... + c[Dims-1],
+// so there is no hash table, indices do not depend on visit order and
+// get_size() is an exact bound on the number of weights needed.
+template <std::size_t Dims>
+class DenseTileCoder
+{
+public:
+    using Floats = std::array<float, Dims>;
+    using Extents = std::array<std::uint32_t, Dims>;
+    using WrapWidths = std::array<std::uint32_t, Dims>;
+
+    DenseTileCoder() { }
+    virtual ~DenseTileCoder() { }
+
+    // Tiles as TileCoder::get_tiles
+    void initialize(const std::uint32_t num_tilings, const Extents& num_tiles);
+    // Tiles as TileCoder::get_tileswrap
+    void initialize(const std::uint32_t num_tilings, const Extents& num_tiles, const WrapWidths& wrap_widths);
+
+    std::vector<std::uint32_t> get_tiles(const Floats& floats);
+    void get_tiles(const Floats& floats, Tiles& tiles);
+    // Write num_tilings indices to tiles
+    void get_tiles(const Floats& floats, std::uint32_t* tiles);
+
+    // Structure of arrays input for n states as TileCoder::get_tiles_batch
+    using FloatArrays = std::array<const float*, Dims>;
+    void get_tiles_batch(const FloatArrays& floats, const std::size_t n, std::uint32_t* tiles);
+
+    std::uint32_t get_num_tilings() const { return num_tilings; }
+    // Number of distinct indices, one per tile of every tiling
+    std::size_t get_size() const { return std::size_t(num_tilings) * stride; }
+
+private:
+    void set_strides();
+    std::uint32_t quantize(const std::size_t d, const float f) const;
+
+    // States coded together by get_tiles_batch
+    static constexpr std::size_t batch_states = 256;
+
+    static constexpr std::uint32_t displacement(const std::size_t d)
+    {
+        return static_cast<std::uint32_t>(2 * d + 1);
+    }
+
+    std::uint32_t num_tilings{0};
+    bool wrapping{false};
+    Extents extents{};      // number of coordinates in each dimension
+    Extents multipliers{};  // row major strides within one tiling
+    WrapWidths wrap_widths{};
+    Extents max_q{};        // largest shifted quantized float in each dimension
+    std::uint32_t stride{0};
+    Divider nt_divider;
+    std::array<Divider, Dims> wrap_dividers;
+};
+
+/* Sizes the slot array to the next power of two holding at least twice
+ * capacity entries, so the load factor never exceeds 1/2. Entries already in
+ * the table keep their indices. In HashOnly mode there is no slot array, only
+ * one fingerprint per index.
+ */
+template <std::size_t KeyWords>
+void IndexHashTable<KeyWords>::set_capacity(const std::size_t _capacity)
+{
+    // The keys held already keep their indices, which must stay below the
+    // capacity, and the smaller table could not hold them all
+    if (size > _capacity && policy != OverflowPolicy::HashOnly)
+        throw std::invalid_argument("index hash table holds more keys than the new capacity; clear it first");
+    capacity = _capacity;
+
+    if (policy == OverflowPolicy::HashOnly)
+    {
+        std::vector<Slot>().swap(slots);
+        mask = 0;
+        fingerprints.assign(capacity, 0);
+        size = 0;
+        return;
+    }
+    std::vector<std::uint32_t>().swap(fingerprints);
+
+    std::size_t num_slots = 8;
+    while (num_slots < 2 * capacity)
+        num_slots <<= 1;
+
+    if (num_slots == slots.size())
+        return;
+
+    std::vector<Slot> old_slots(num_slots);
+    old_slots.swap(slots);
+    mask = num_slots - 1;
+
+    for (const auto& s : old_slots)
+    {
+        if (s.key[0] == 0)
+            continue;
+
+        std::size_t i = hash(s.key) & mask;
+        while (slots[i].key[0] != 0)
+            i = (i + 1) & mask;
+        slots[i] = s;
+    }
+}
+
+/* Switching to or from HashOnly drops the current contents of the table */
+template <std::size_t KeyWords>
+void IndexHashTable<KeyWords>::set_overflow_policy(const OverflowPolicy _policy)
+{
+    if (_policy == policy)
+        return;
+
+    bool was_hash_only = (policy == OverflowPolicy::HashOnly);
+    policy = _policy;
+    if (was_hash_only || policy == OverflowPolicy::HashOnly)
+    {
+        slots.clear();
+        size = 0;
+        set_capacity(capacity);
+    }
+}
+
+template <std::size_t KeyWords>
+void IndexHashTable<KeyWords>::clear()
+{
+    std::fill(slots.begin(), slots.end(), Slot{});
+    std::fill(fingerprints.begin(), fingerprints.end(), 0);
+    size = 0;
+    collision_count = 0;
+}
+
+template <std::size_t KeyWords>
+std::uint32_t IndexHashTable<KeyWords>::get_index(const KeyType& k)
+{
+    if (policy == OverflowPolicy::HashOnly)
+        return get_hashed_index(k);
+
+    return probe(k, hash(k));
+}
+
+template <std::size_t KeyWords>
+void IndexHashTable<KeyWords>::get_indices(const KeyType* keys, const std::size_t n, std::uint32_t* indices)
+{
+    if (policy == OverflowPolicy::HashOnly)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            indices[i] = get_hashed_index(keys[i]);
+        return;
+    }
+
+    constexpr std::size_t batch_size = 16;
+    std::array<std::uint64_t, batch_size> hashes;
+    for (std::size_t first = 0; first < n; first += batch_size)
+    {
+        const std::size_t count = std::min(n - first, batch_size);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            hashes[i] = hash(keys[first + i]);
+#if defined(__GNUC__)
+            __builtin_prefetch(&slots[hashes[i] & mask]);
+#endif
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            indices[first + i] = probe(keys[first + i], hashes[i]);
+    }
+}
+
+/* Probes linearly from the home slot of hash h, inserting k into the first
+ * empty slot if it is not already in the table.
+ */
+template <std::size_t KeyWords>
+std::uint32_t IndexHashTable<KeyWords>::probe(const KeyType& k, const std::uint64_t h)
+{
+    std::size_t i = h & mask;
+    while (true)
+    {
+        Slot& s = slots[i];
+        if (s.key == k)
+            return s.index;
+        if (s.key[0] == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    if (size >= capacity)
+    {
+        if (policy == OverflowPolicy::Throw || capacity == 0)
+            throw(std::out_of_range("TileCoder: index hash table full"));
+
+        if (collision_count == 0)
+            std::printf("TileCoder: index hash table full, allowing collisions\n");
+        ++collision_count;
+        return h % capacity;
+    }
+
+    slots[i].key = k;
+    slots[i].index = size;
+    return size++;
+}
+
+/* tiles3 style hashing with no table; a collision is counted whenever an
+ * index was last used by a key with a different fingerprint.
+ */
+template <std::size_t KeyWords>
+std::uint32_t IndexHashTable<KeyWords>::get_hashed_index(const KeyType& k)
+{
+    if (capacity == 0)
+        throw(std::out_of_range("TileCoder: index hash table has no capacity"));
+
+    auto h = hash(k);
+    std::uint32_t index = h % capacity;
+    std::uint32_t fingerprint = static_cast<std::uint32_t>(h >> 32) | 1;
+
+    auto& owner = fingerprints[index];
+    if (owner == 0)
+        ++size;
+    else if (owner != fingerprint)
+        ++collision_count;
+    owner = fingerprint;
+
+    return index;
+}
+
+template <std::size_t KeyWords>
+void IndexHashTable<KeyWords>::save(const std::string& path) const
+{
+    if (policy == OverflowPolicy::HashOnly)
+        throw(std::invalid_argument("IndexHashTable: HashOnly keeps no keys to save"));
+
+    std::vector<typename MappedIndexHashTable<KeyWords>::Entry> entries;
+    entries.reserve(size);
+    for (const auto& s : slots)
+        if (s.key[0] != 0)
+            entries.emplace_back(s.key, s.index);
+    MappedIndexHashTable<KeyWords>::write(path, capacity, entries);
+}
+
+/* Sized like IndexHashTable, at least twice capacity slots, so probe runs stay
+ * short and claims that race past a full table still find empty slots.
+ */
+template <std::size_t KeyWords>
+ConcurrentIndexHashTable<KeyWords>::ConcurrentIndexHashTable(
+        const std::size_t _capacity, const OverflowPolicy _policy)
+    : capacity(_capacity), policy(_policy)
+{
+    if (policy != OverflowPolicy::Throw)
+        throw(std::invalid_argument("ConcurrentIndexHashTable: only the Throw overflow policy "
+                                    "keeps runs reproducible"));
+
+    std::size_t num_slots = 8;
+    while (num_slots < 2 * capacity)
+        num_slots <<= 1;
+
+    slots.reset(new Slot[num_slots]);
+    mask = num_slots - 1;
+}
+
+template <std::size_t KeyWords>
+std::uint32_t ConcurrentIndexHashTable<KeyWords>::get_index(const KeyType& k)
+{
+    return probe(k, IndexHashTable<KeyWords>::hash(k));
+}
+
+template <std::size_t KeyWords>
+void ConcurrentIndexHashTable<KeyWords>::get_indices(
+        const KeyType* keys, const std::size_t n, std::uint32_t* indices)
+{
+    constexpr std::size_t batch_size = 16;
+    std::array<std::uint64_t, batch_size> hashes;
+    for (std::size_t first = 0; first < n; first += batch_size)
+    {
+        const std::size_t count = std::min(n - first, batch_size);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            hashes[i] = IndexHashTable<KeyWords>::hash(keys[first + i]);
+#if defined(__GNUC__)
+            __builtin_prefetch(&slots[hashes[i] & mask]);
+#endif
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            indices[first + i] = probe(keys[first + i], hashes[i]);
+    }
+}
+
+/* The key words are written before the slot is published with a release
+ * store, and read only after its state was loaded with acquire, so a reader
+ * never sees a partly written key.
+ */
+template <std::size_t KeyWords>
+std::uint32_t ConcurrentIndexHashTable<KeyWords>::probe(const KeyType& k, const std::uint64_t h)
+{
+    std::size_t i = h & mask;
+    for (std::size_t probes = 0; probes <= mask; )
+    {
+        Slot& s = slots[i];
+        std::uint32_t state = s.state.load(std::memory_order_acquire);
+
+        if (state == empty)
+        {
+            if (is_frozen() || size.load(std::memory_order_relaxed) >= capacity)
+                return overflow(h);
+
+            // Another thread claimed the slot first; look at it again
+            if (!s.state.compare_exchange_strong(state, claimed, std::memory_order_acquire))
+                continue;
+
+            s.key = k;
+            std::size_t n = size.fetch_add(1, std::memory_order_relaxed);
+            if (n >= capacity)
+            {
+                // Raced past the last free index; release the slot as rejected
+                // so that later lookups of the key do not wait on it forever
+                s.state.store(rejected, std::memory_order_release);
+                return overflow(h);
+            }
+            s.state.store(published + static_cast<std::uint32_t>(n), std::memory_order_release);
+            return static_cast<std::uint32_t>(n);
+        }
+
+        while (state == claimed)
+        {
+            std::this_thread::yield();
+            state = s.state.load(std::memory_order_acquire);
+        }
+        if (s.key == k)
+            return state == rejected ? overflow(h) : state - published;
+
+        i = (i + 1) & mask;
+        ++probes;
+    }
+    return overflow(h);
+}
+
+template <std::size_t KeyWords>
+void ConcurrentIndexHashTable<KeyWords>::save(const std::string& path) const
+{
+    std::vector<typename MappedIndexHashTable<KeyWords>::Entry> entries;
+    for (std::size_t i = 0; i <= mask; ++i)
+    {
+        std::uint32_t state = slots[i].state.load(std::memory_order_acquire);
+        if (state >= published)
+            entries.emplace_back(slots[i].key, state - published);
+    }
+    MappedIndexHashTable<KeyWords>::write(path, capacity, entries);
+}
+
+template <std::size_t KeyWords>
+std::uint32_t ConcurrentIndexHashTable<KeyWords>::overflow(const std::uint64_t)
+{
+    throw(std::out_of_range(is_frozen() ? "TileCoder: key not in frozen index hash table"
+                                        : "TileCoder: index hash table full"));
+}
+
+/* The slot array is rebuilt at the next power of two holding at least twice
+ * the entries, rather than twice the capacity, so the file stays compact.
+ */
+template <std::size_t KeyWords>
+void MappedIndexHashTable<KeyWords>::write(
+        const std::string& path, const std::size_t capacity, const std::vector<Entry>& entries)
+{
+    std::size_t num_slots = 8;
+    while (num_slots < 2 * entries.size())
+        num_slots <<= 1;
+
+    std::vector<Slot> table(num_slots, Slot{KeyType{}, 0});
+    for (const auto& e : entries)
+    {
+        std::size_t i = IndexHashTable<KeyWords>::hash(e.first) & (num_slots - 1);
+        while (table[i].key[0] != 0)
+            i = (i + 1) & (num_slots - 1);
+        table[i] = Slot{e.first, e.second};
+    }
+
+    const Header header{magic, KeyWords, capacity, entries.size(), num_slots};
+    std::vector<char> contents(sizeof(Header) + num_slots * sizeof(Slot));
+    std::memcpy(contents.data(), &header, sizeof(Header));
+    std::memcpy(contents.data() + sizeof(Header), table.data(), num_slots * sizeof(Slot));
+    write_file(path, contents);
+}
+
+template <std::size_t KeyWords>
+MappedIndexHashTable<KeyWords>::MappedIndexHashTable(const std::string& path, const OverflowPolicy _policy)
+    : policy(_policy)
+{
+    if (policy == OverflowPolicy::HashOnly)
+        throw(std::invalid_argument("MappedIndexHashTable: HashOnly needs no table"));
+
+    file = map_file(path);
+    header = static_cast<const Header*>(file.data);
+    if (file.size < sizeof(Header) || header->magic != magic || header->key_words != KeyWords ||
+        header->num_slots == 0 || (header->num_slots & (header->num_slots - 1)) != 0 ||
+        file.size != sizeof(Header) + header->num_slots * sizeof(Slot))
+    {
+        unmap_file(file);
+        throw(std::runtime_error("MappedIndexHashTable: " + path + " is not an index table"));
+    }
+
+    slots = reinterpret_cast<const Slot*>(static_cast<const char*>(file.data) + sizeof(Header));
+    mask = header->num_slots - 1;
+}
+
+template <std::size_t KeyWords>
+std::uint32_t MappedIndexHashTable<KeyWords>::get_index(const KeyType& k) const
+{
+    const std::uint64_t h = IndexHashTable<KeyWords>::hash(k);
+    std::size_t i = h & mask;
+    for (std::size_t probes = 0; probes <= mask; ++probes)
+    {
+        const Slot& s = slots[i];
+        if (s.key == k)
+            return s.index;
+        if (s.key[0] == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return overflow(h);
+}
+
+template <std::size_t KeyWords>
+void MappedIndexHashTable<KeyWords>::get_indices(
+        const KeyType* keys, const std::size_t n, std::uint32_t* indices)
+{
+    for (std::size_t i = 0; i < n; ++i)
+        indices[i] = get_index(keys[i]);
+}
+
+template <std::size_t KeyWords>
+std::uint32_t MappedIndexHashTable<KeyWords>::overflow(const std::uint64_t h) const
+{
+    if (policy == OverflowPolicy::Throw || header->capacity == 0)
+        throw(std::out_of_range("TileCoder: key not in mapped index table"));
+
+    if (collision_count.fetch_add(1, std::memory_order_relaxed) == 0)
+        std::printf("TileCoder: key not in mapped index table, allowing collisions\n");
+    return h % header->capacity;
+}
+
+/* Keys are (tiling + 1, coordinates...), looked up in tiling order so that
+ * new tiles are given indices in the same order as one call per tiling.
+ */
+template <std::size_t Dims>
+void TileCoder<Dims>::lookup(const std::uint32_t first, const std::uint32_t count,
+                             const Coords& coords, std::uint32_t* tiles)
+{
+    std::array<KeyType, block_size> keys;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        keys[i][0] = first + i + 1;
+        for (std::size_t d = 0; d < Dims; ++d)
+            keys[i][d + 1] = coords[d][i];
+    }
+    get_indices(keys.data(), count, tiles);
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tiles(const std::uint32_t num_tilings, const Floats& floats, std::uint32_t* tiles)
+{
+    const Ints qfloats = quantize(num_tilings, floats);
+    const Divider& nt = tilings_divider(num_tilings);
+
+    Coords coords;
+    for (std::uint32_t first = 0; first < num_tilings; first += block_size)
+    {
+        const std::uint32_t count = std::min(num_tilings - first, block_size);
+        for (std::size_t d = 0; d < Dims; ++d)
+            tiling_coords(qfloats[d], displacement(d), first, count, nt, coords[d].data());
+        lookup(first, count, coords, tiles + first);
+    }
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tileswrap(
+        const std::uint32_t num_tilings, const Floats& floats,
+        const WrapWidths& wrap_widths, std::uint32_t* tiles)
+{
+    const Ints qfloats = quantize(num_tilings, floats);
+    const Divider& nt = tilings_divider(num_tilings);
+
+    Coords coords;
+    for (std::uint32_t first = 0; first < num_tilings; first += block_size)
+    {
+        const std::uint32_t count = std::min(num_tilings - first, block_size);
+        for (std::size_t d = 0; d < Dims; ++d)
+            tiling_coords_wrap(qfloats[d], displacement(d), first, count, nt,
+                               wrap_divider(d, wrap_widths[d]), coords[d].data());
+        lookup(first, count, coords, tiles + first);
+    }
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tiles_batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+                                      const std::size_t n, std::uint32_t* tiles)
+{
+    batch(num_tilings, floats, nullptr, n, tiles);
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tileswrap_batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+                                          const WrapWidths& wrap_widths, const std::size_t n, std::uint32_t* tiles)
+{
+    batch(num_tilings, floats, &wrap_widths, n, tiles);
+}
+
+/* Codes blocks of batch_keys / num_tilings states. Coordinates are computed
+ * tiling by tiling across the states of a block, then all keys of the block
+ * are looked up in one get_indices call, state by state and tiling by tiling.
+ */
+template <std::size_t Dims>
+void TileCoder<Dims>::batch(const std::uint32_t num_tilings, const FloatArrays& floats,
+                            const WrapWidths* wrap_widths, const std::size_t n, std::uint32_t* tiles)
+{
+    if (num_tilings > batch_keys)
+    {
+        Floats state;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t d = 0; d < Dims; ++d)
+                state[d] = floats[d][i];
+            if (wrap_widths)
+                get_tileswrap(num_tilings, state, *wrap_widths, tiles + i * num_tilings);
+            else
+                get_tiles(num_tilings, state, tiles + i * num_tilings);
+        }
+        return;
+    }
+
+    const Divider& nt = tilings_divider(num_tilings);
+    const std::size_t block_states = batch_keys / num_tilings;
+
+    std::array<std::array<std::uint32_t, batch_keys>, Dims> qfloats;
+    std::array<std::uint32_t, batch_keys> coords;
+    std::array<KeyType, batch_keys> keys;
+    for (std::size_t first = 0; first < n; first += block_states)
+    {
+        const std::size_t count = std::min(n - first, block_states);
+        for (std::size_t d = 0; d < Dims; ++d)
+            for (std::size_t i = 0; i < count; ++i)
+                qfloats[d][i] = static_cast<std::uint32_t>(
+                        static_cast<int>(std::floor(floats[d][first + i] * num_tilings)));
+
+        for (std::uint32_t tiling = 0; tiling < num_tilings; ++tiling)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                keys[i * num_tilings + tiling][0] = tiling + 1;
+
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                const Divider* wrap = wrap_widths ? wrap_divider(d, (*wrap_widths)[d]) : nullptr;
+                const std::uint32_t offset = wrap_widths ? nt.modulo(tiling * displacement(d))
+                                                         : tiling * displacement(d);
+                state_coords(qfloats[d].data(), count, offset, nt, wrap, coords.data());
+                for (std::size_t i = 0; i < count; ++i)
+                    keys[i * num_tilings + tiling][d + 1] = coords[i];
+            }
+        }
+        get_indices(keys.data(), count * num_tilings, tiles + first * num_tilings);
+    }
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tiles(const std::uint32_t num_tilings, const Floats& floats, Tiles& tiles)
+{
+    tiles.resize(num_tilings);
+    get_tiles(num_tilings, floats, tiles.data());
+}
+
+template <std::size_t Dims>
+void TileCoder<Dims>::get_tileswrap(
+        const std::uint32_t num_tilings, const Floats& floats,
+        const WrapWidths& wrap_widths, Tiles& tiles)
+{
+    tiles.resize(num_tilings);
+    get_tileswrap(num_tilings, floats, wrap_widths, tiles.data());
+}
+
+template <std::size_t Dims>
+std::vector<std::uint32_t> TileCoder<Dims>::get_tiles(const std::uint32_t num_tilings, const Floats& floats)
+{
+    std::vector<uint32_t> tiles(num_tilings);
+    get_tiles(num_tilings, floats, tiles.data());
+    return tiles;
+}
+
+template <std::size_t Dims>
+std::vector<std::uint32_t> TileCoder<Dims>::get_tileswrap(
+        const std::uint32_t num_tilings, const Floats& floats,
+        const WrapWidths& wrap_widths)
+{
+    std::vector<uint32_t> tiles(num_tilings);
+    get_tileswrap(num_tilings, floats, wrap_widths, tiles.data());
+    return tiles;
+}
+
+/* Quantized floats q are shifted up by one tile, q + num_tilings, so that
+ * they lie in [0, (num_tiles + 1) * num_tilings]. In tiling t the shifted
+ * coordinate (q + num_tilings + t * displacement) / num_tilings is then at
+ * most num_tiles + 1 + (num_tilings - 1) * displacement / num_tilings.
+ */
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::initialize(const std::uint32_t _num_tilings, const Extents& num_tiles)
+{
+    num_tilings = _num_tilings;
+    wrapping = false;
+    wrap_widths = {};
+    for (std::size_t d = 0; d < Dims; ++d)
+    {
+        max_q[d] = (num_tiles[d] + 1) * num_tilings;
+        extents[d] = num_tiles[d] + (num_tilings - 1) * displacement(d) / num_tilings + 2;
+    }
+    set_strides();
+}
+
+/* When wrapping the displacement is taken modulo num_tilings, so shifted
+ * unwrapped coordinates are at most num_tiles + 1 and wrapped ones, which are
+ * not shifted, less than the wrap width.
+ */
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::initialize(
+        const std::uint32_t _num_tilings, const Extents& num_tiles, const WrapWidths& _wrap_widths)
+{
+    num_tilings = _num_tilings;
+    wrapping = true;
+    wrap_widths = _wrap_widths;
+    for (std::size_t d = 0; d < Dims; ++d)
+    {
+        max_q[d] = (num_tiles[d] + 1) * num_tilings;
+        extents[d] = (wrap_widths[d] > 0) ? wrap_widths[d] : num_tiles[d] + 2;
+    }
+    set_strides();
+}
+
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::set_strides()
+{
+    if (num_tilings == 0)
+        throw(std::out_of_range("DenseTileCoder: no tilings"));
+
+    std::uint64_t size = 1;
+    for (std::size_t d = Dims; d-- > 0; )
+    {
+        multipliers[d] = static_cast<std::uint32_t>(size);
+        size *= extents[d];
+    }
+    if (size * num_tilings > UINT32_MAX)
+        throw(std::out_of_range("DenseTileCoder: too many tiles"));
+    stride = static_cast<std::uint32_t>(size);
+
+    nt_divider = Divider(num_tilings);
+    for (std::size_t d = 0; d < Dims; ++d)
+        wrap_dividers[d] = Divider(wrap_widths[d] > 0 ? wrap_widths[d] : 1);
+}
+
+/* Floats outside the box are clamped to its edges, except in wrapped
+ * dimensions where the coordinate wraps around as usual.
+ */
+template <std::size_t Dims>
+std::uint32_t DenseTileCoder<Dims>::quantize(const std::size_t d, const float f) const
+{
+    int q = static_cast<int>(std::floor(f * num_tilings));
+    if (wrapping && wrap_widths[d] > 0)
+        return static_cast<std::uint32_t>(q);
+    return std::min(static_cast<std::uint32_t>(std::max(q + static_cast<int>(num_tilings), 0)), max_q[d]);
+}
+
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::get_tiles(const Floats& floats, std::uint32_t* tiles)
+{
+    std::array<std::uint32_t, Dims> qfloats;
+    for (std::size_t d = 0; d < Dims; ++d)
+        qfloats[d] = quantize(d, floats[d]);
+
+    constexpr std::uint32_t block_size = Tiles::max_tilings;
+    std::array<std::uint32_t, block_size> coords;
+    for (std::uint32_t first = 0; first < num_tilings; first += block_size)
+    {
+        const std::uint32_t count = std::min(num_tilings - first, block_size);
+        for (std::uint32_t i = 0; i < count; ++i)
+            tiles[first + i] = (first + i) * stride;
+
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            if (wrapping)
+                tiling_coords_wrap(qfloats[d], displacement(d), first, count, nt_divider,
+                                   wrap_widths[d] > 0 ? &wrap_dividers[d] : nullptr, coords.data());
+            else
+                tiling_coords(qfloats[d], displacement(d), first, count, nt_divider, coords.data());
+
+            for (std::uint32_t i = 0; i < count; ++i)
+                tiles[first + i] += coords[i] * multipliers[d];
+        }
+    }
+}
+
+/* Tiling by tiling over a block of states, so the coordinate math is
+ * vectorized across states.
+ */
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::get_tiles_batch(const FloatArrays& floats, const std::size_t n, std::uint32_t* tiles)
+{
+    std::array<std::array<std::uint32_t, batch_states>, Dims> qfloats;
+    std::array<std::uint32_t, batch_states> coords;
+    for (std::size_t first = 0; first < n; first += batch_states)
+    {
+        const std::size_t count = std::min(n - first, batch_states);
+        for (std::size_t d = 0; d < Dims; ++d)
+            for (std::size_t i = 0; i < count; ++i)
+                qfloats[d][i] = quantize(d, floats[d][first + i]);
+
+        std::uint32_t* block = tiles + first * num_tilings;
+        for (std::uint32_t tiling = 0; tiling < num_tilings; ++tiling)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                block[i * num_tilings + tiling] = tiling * stride;
+
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                const Divider* wrap = (wrapping && wrap_widths[d] > 0) ? &wrap_dividers[d] : nullptr;
+                const std::uint32_t offset = wrapping ? nt_divider.modulo(tiling * displacement(d))
+                                                      : tiling * displacement(d);
+                state_coords(qfloats[d].data(), count, offset, nt_divider, wrap, coords.data());
+                for (std::size_t i = 0; i < count; ++i)
+                    block[i * num_tilings + tiling] += coords[i] * multipliers[d];
+            }
+        }
+    }
+}
+
+template <std::size_t Dims>
+void DenseTileCoder<Dims>::get_tiles(const Floats& floats, Tiles& tiles)
+{
+    tiles.resize(num_tilings);
+    get_tiles(floats, tiles.data());
+}
+
+template <std::size_t Dims>
+std::vector<std::uint32_t> DenseTileCoder<Dims>::get_tiles(const Floats& floats)
+{
+    std::vector<uint32_t> tiles(num_tilings);
+    get_tiles(floats, tiles.data());
+    return tiles;
+}
+
+// The two dimensional coders used by the tasks are instantiated once in tc.cpp
+extern template class IndexHashTable<3>;
+extern template class TileCoder<2>;
+extern template class DenseTileCoder<2>;
+extern template class ConcurrentIndexHashTable<3>;
+extern template class MappedIndexHashTable<3>;
+
 } // namespace tc
@@ -1,6 +1,9 @@
 
 #include <algorithm>
-#include <random>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include "actor_critic_agent.hpp"
 
@@ -15,7 +18,8 @@ using range = boost::multi_array_types::index_range;
 /* Setup for the agent when the RL environment starts.
  *     AgentInit is a structured class of parameters used to initialize the agent.
  */
-void ActorCriticAgent::agent_init(const AgentInit& params)
+template <class S, class F>
+void ActorCriticAgentT<S, F>::agent_init(const AgentInit& params)
 {
     num_actions = params.num_actions;
     num_states = params.num_states;
@@ -24,6 +28,9 @@ void ActorCriticAgent::agent_init(const AgentInit& params)
     discount = params.discount;
     seed = params.seed;
 
+    if (num_actions > max_actions)
+        throw(std::out_of_range("ActorCriticAgent: too many actions"));
+
     // Additional parameters for tile coding
     num_tilings = params.num_tilings;
     num_tiles = params.num_tiles;
@@ -34,28 +41,33 @@ void ActorCriticAgent::agent_init(const AgentInit& params)
     critic_step_size = params.critic_step_size;
     avg_reward_step_size = params.avg_reward_step_size;
 
-    gen.seed(seed);  // seed the random number generator
+    gen = rng::make_engine(seed, params.run, rng::agent_stream);
     avg_reward = 0;
+    prev_vhat_valid = false;
     // Initialize the tile coder
-    tc.initialize(index_hash_table_size, num_tilings, num_tiles);
+    tc.initialize(index_hash_table_size, num_tilings, num_tiles, params.overflow_policy,
+                  params.tile_indexing);
+    if (params.shared_index_table)
+    {
+        if (params.shared_index_table->get_capacity() > index_hash_table_size)
+            throw(std::out_of_range("ActorCriticAgent: shared index table larger than the weights"));
+        tc.share_table(params.shared_index_table);
+    }
 
     // Using linear function approximation; need a set of weights for each action
     // The weights essentially replace the q_values which are simply weights^T * x(s, a)
     // where the feature vector, x(s,a), is just the one-hot vector of active tiles
-    Float2D::extent_gen extents;
-    actor_weights.resize(extents[num_actions][index_hash_table_size]);
-    critic_weights.resize(index_hash_table_size);
+    actor_weights.resize(num_actions, index_hash_table_size, params.weight_layout);
+    lambda = params.lambda;
+    traces.resize(index_hash_table_size, actor_weights.get_padded_actions() + 1,
+                  params.trace_type, params.trace_threshold);
 
-    using index = Float2D::index;
-
-    for(index i = 0; i < num_actions; ++i)
-      for(index j = 0; j < index_hash_table_size; ++j)
-          actor_weights[i][j] = 0.0;
+    critic_weights.resize(index_hash_table_size);
 
       for(int j = 0; j < index_hash_table_size; ++j)
           critic_weights[j] = 0.0;
 
-    softmax_prob.resize(num_actions);
+    softmax_prob.fill(0);
 
     prev_state = {0, 0};
     prev_action = 0;
@@ -66,68 +78,67 @@ void ActorCriticAgent::agent_init(const AgentInit& params)
  * Args:
  *   actor_weights - vector of actor weights for each action
  *   tiles - vector of active tiles
- *
- * Returns:
- * softmax_prob - array of probabilities for each action which sum to 1.
+ *   p - receives num_actions probabilities which sum to 1
  */
-std::vector<double> ActorCriticAgent::get_softmax_prob(
-    const Float2D& actor_weights, const std::vector<uint32_t>& tiles)
+template <class S, class F>
+void ActorCriticAgentT<S, F>::get_softmax_prob(
+    const ActionWeights<S, F>& actor_weights, const TileSpan tiles, F* p)
 {
-    //auto num_actions = actor_weights.shape()[0];
-    std::vector<double> p(num_actions, 0);
-
     // Form the action preferences, h(s, a, theta)
+    std::array<F, max_actions> q_values{};
+    actor_weights.add_action_values(tiles, q_values.data());
 
-    std::vector<double> q_values(num_actions, 0);
-    for(Action a = 0; a < num_actions; ++a)
-    {
-        for (std::size_t j=0; j < tiles.size(); ++j)
-            q_values[a] += actor_weights[a][tiles[j]];
-    }
-
-    auto c = *std::max_element(q_values.cbegin(), q_values.cend());
+    auto c = *std::max_element(q_values.cbegin(), q_values.cbegin() + num_actions);
 
-    std::vector<double> numerator(num_actions, 0);
-    double denominator{0};
+    F denominator{0};
     for (std::size_t i = 0; i < num_actions; ++i)
     {
-        numerator[i] = std::exp(q_values[i] - c);
-        denominator += numerator[i];
+        p[i] = std::exp(q_values[i] - c);
+        denominator += p[i];
     }
 
     for (std::size_t i = 0; i < num_actions; ++i)
-        p[i] = static_cast<double>(numerator[i] / denominator);
-
-    return p;
+        p[i] /= denominator;
 }
 
-Action ActorCriticAgent::agent_policy(const std::vector<std::uint32_t>& tiles)
+template <class S, class F>
+Action ActorCriticAgentT<S, F>::agent_policy(const TileSpan tiles)
 {
     // Compute the softmax probability
-    softmax_prob = get_softmax_prob(actor_weights, tiles);
+    get_softmax_prob(actor_weights, tiles, softmax_prob.data());
 
     // Sample action from the softmax probability array
-    // Select an element from the array with the specified probability
-    static const std::vector<double> i{ 0, 1, 2, 3 };
-    std::piecewise_constant_distribution<double> d(i.begin(), i.end(),
-            softmax_prob.begin());
-    Action action = d(gen);
+    return rng::categorical(gen, softmax_prob.data(), num_actions);
+}
 
-    return action;
+/* vhat(S, w), the sum of the critic weights of the active tiles */
+template <class S, class F>
+F ActorCriticAgentT<S, F>::state_value(const TileSpan tiles) const
+{
+    F vhat{0};
+    for (std::size_t j=0; j < tiles.size(); ++j)
+        vhat += critic_weights[tiles[j]];
+    return vhat;
 }
 
 /* The first method called after the RL environment starts.
  *     Input: the state from the environmnent's env_start method.
  *     Returns: the first action taken by the agent.
  */
-Action ActorCriticAgent::agent_start(const State state)
+template <class S, class F>
+Action ActorCriticAgentT<S, F>::agent_start(const State state)
 {
-    auto tiles = tc.get_tiles(state.angle, state.velocity);
+    auto& tiles = tile_buffers.next();
+    tc.get_tiles(state.angle, state.velocity, tiles);
     Action action = agent_policy(tiles);
 
+    prev_vhat = state_value(tiles);
+    prev_vhat_valid = true;
+    traces.clear();
+
     //prev_state = state;
     prev_action = action;
-    prev_tiles = tiles;
+    tile_buffers.swap();
 
     return action;
 }
@@ -138,66 +149,134 @@ Action ActorCriticAgent::agent_start(const State state)
  *            state from the environment's last step
  *     Returns: the action the agent is taking
  */
-Action ActorCriticAgent::agent_step(const double reward, const State state)
+template <class S, class F>
+Action ActorCriticAgentT<S, F>::agent_step(const double reward, const State state)
 {
-    auto tiles = tc.get_tiles(state.angle, state.velocity);
-    Action action = agent_policy(tiles);
-
-    double vhat{0};
-    double prev_vhat{0};
+    auto& tiles = tile_buffers.next();
+    tc.get_tiles(state.angle, state.velocity, tiles);
+    const auto& prev_tiles = tile_buffers.prev();
 
-    for (std::size_t j=0; j < tiles.size(); ++j)
-        vhat += critic_weights[tiles[j]];
-
-    for (std::size_t j=0; j < prev_tiles.size(); ++j)
-        prev_vhat += critic_weights[prev_tiles[j]];
+    F vhat = state_value(tiles);
+    if (!prev_vhat_valid)
+        prev_vhat = state_value(prev_tiles);
 
     // Compute delta
-    double delta = (reward - avg_reward) + (vhat - prev_vhat);
+    F delta = (reward - avg_reward) + (vhat - prev_vhat);
 
     // Update average reward
     avg_reward += avg_reward_step_size * delta;
 
-    // Update critic weights
-    // grad = np.ones(len(self.prev_tiles))  # grad(vhat(S, w)) = x(S)
-    // critic_weights[prev_tiles] += critic_step_size * delta * grad
-    for (std::size_t j=0; j < prev_tiles.size(); ++j)
-        critic_weights[prev_tiles[j]] += critic_step_size * delta;
+    if (lambda > 0)
+    {
+        update_traced_weights(delta);
+        prev_vhat_valid = false;
 
-    // Update actor weights
-    // Use softmax_prob saved from the previous time step
+        Action action = agent_policy(tiles);
+
+        prev_state = state;
+        prev_action = action;
+        tile_buffers.swap();
+
+        return action;
+    }
+
+    // Update the critic and actor weights of the previous tiles in one pass:
+    //   critic_weights[prev_tiles] += critic_step_size * delta * grad(vhat) = x(S)
+    //   actor_weights[a][prev_tiles] += actor_step_size * delta * (1[a == A] - pi(a|S))
+    // with the policy saved from the previous time step
+    const F critic_delta = critic_step_size * delta;
+    std::array<F, max_actions> actor_deltas{};
     for (Action a = 0; a < num_actions; ++a)
+        actor_deltas[a] = actor_step_size * delta * ((a == prev_action) - softmax_prob[a]);
+
+    for (std::size_t j=0; j < prev_tiles.size(); ++j)
     {
-        if (a == prev_action)
-            for (std::size_t j=0; j < prev_tiles.size(); ++j)
-                actor_weights[a][prev_tiles[j]] += actor_step_size * delta * (1.0 - softmax_prob[a]);
-        else
-            for (std::size_t j=0; j < prev_tiles.size(); ++j)
-                actor_weights[a][prev_tiles[j]] += actor_step_size * delta * (0.0 - softmax_prob[a]);
+        critic_weights[prev_tiles[j]] += critic_delta;
+        actor_weights.add(prev_tiles[j], actor_deltas.data());
     }
+
+    // The critic update moved vhat by critic_delta for every tiling both
+    // states share. Adding that to vhat matches summing the weights again
+    // up to rounding, as long as no two tilings share a weight and the
+    // weights are stored at full precision; vhat itself is summed afresh
+    // every step, so the rounding does not build up
+    std::size_t shared_tiles = 0;
+    for (std::size_t k=0; k < tiles.size(); ++k)
+        shared_tiles += (tiles[k] == prev_tiles[k]);
+    prev_vhat = vhat + shared_tiles * critic_delta;
+    prev_vhat_valid = std::is_same<S, F>::value && tc.get_collision_count() == 0;
+
+    Action action = agent_policy(tiles);
+
     prev_state = state;
     prev_action = action;
-    prev_tiles = tiles;
+    tile_buffers.swap();
 
     return action;
 }
 
+/* Actor-critic(lambda): refreshes the traces of the previous tiles with
+ * the gradients x(S) and (1[a == A] - pi(a|S)), moves every traced weight
+ * by its step size * delta * z, then decays the traces by lambda. Each
+ * trace holds the actor values followed by the critic value, so both sets
+ * of weights are updated in one pass over the traces.
+ */
+template <class S, class F>
+void ActorCriticAgentT<S, F>::update_traced_weights(const F delta)
+{
+    const std::size_t critic = actor_weights.get_padded_actions();
+    std::array<F, max_actions + 1> gradient{};
+    for (Action a = 0; a < num_actions; ++a)
+        gradient[a] = (a == prev_action) - softmax_prob[a];
+    gradient[critic] = 1;
+
+    const auto& prev_tiles = tile_buffers.prev();
+    for (std::size_t j=0; j < prev_tiles.size(); ++j)
+        traces.add(prev_tiles[j], gradient.data());
+
+    const F critic_delta = critic_step_size * delta;
+    const F actor_delta = actor_step_size * delta;
+    for (std::size_t i=0; i < traces.size(); ++i)
+    {
+        const F* z = traces.trace(i);
+        critic_weights[traces.key(i)] += critic_delta * z[critic];
+        actor_weights.add(traces.key(i), z, actor_delta);
+    }
+
+    traces.decay(lambda);
+}
+
 /* Runs when the agent terminates.
  *     Input: reward the agent received for reaching the terminal state
  */
-void ActorCriticAgent::agent_end(const double reward)
+template <class S, class F>
+void ActorCriticAgentT<S, F>::agent_end(const double reward)
 {
     // No need to implement agent_end() as there is no termination in a
     // continuing task.
     (void)reward;
 }
 
-void ActorCriticAgent::agent_cleanup() { }
+template <class S, class F>
+void ActorCriticAgentT<S, F>::agent_cleanup() { }
 
-std::string ActorCriticAgent::agent_message(const std::string& message)
+template <class S, class F>
+std::string ActorCriticAgentT<S, F>::agent_message(const std::string& message)
 {
     if (message == "get avg reward")
         return std::to_string(avg_reward);
+    else if (message == "get collisions")
+        return std::to_string(tc.get_collision_count());
+    else if (message.compare(0, 17, "save index table ") == 0)
+    {
+        tc.save_table(message.substr(17));
+        return std::string("saved");
+    }
     else
         return std::string("");
 }
+
+template class ActorCriticAgentT<float, float>;
+template class ActorCriticAgentT<float, double>;
+template class ActorCriticAgentT<double, double>;
+template class ActorCriticAgentT<bfloat16, float>;
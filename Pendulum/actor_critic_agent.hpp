@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdio>
 #include <vector>
 #include "rl_agent.hpp"
@@ -22,11 +23,13 @@ struct ActorCriticInit : public AgentInit
     double avg_reward_step_size{0};
 };
 
-class ActorCriticAgent : public Agent
+// Actor-critic with weights stored as S and updated in F, see ActionWeights
+template <class S, class F>
+class ActorCriticAgentT : public Agent
 {
 public:
-    ActorCriticAgent() : Agent() { };
-    ~ActorCriticAgent() {};
+    ActorCriticAgentT() : Agent() { };
+    ~ActorCriticAgentT() {};
 
     virtual void agent_init(const AgentInit& params) override;
     virtual Action agent_start(const State state) override;
@@ -41,21 +44,35 @@ protected:
     unsigned int num_tiles{0};
     unsigned int index_hash_table_size{0};
     PendulumTileCoder tc;
-    std::vector<uint32_t> prev_tiles;
+    TileBuffers tile_buffers;  // active tiles of the previous and next state
 
     double actor_step_size{0};
     double critic_step_size{0};
     double avg_reward_step_size{0};
 
-    double avg_reward{0};
+    F avg_reward{0};
 
-    std::vector<double> get_softmax_prob(
-        const Float2D& actor_weights, const std::vector<uint32_t>& tiles);
-    Action agent_policy(const std::vector<uint32_t>& tiles);
+    // vhat of the previous tiles under the current critic weights, up to
+    // rounding
+    F prev_vhat{0};
+    bool prev_vhat_valid{false};
+    F state_value(const TileSpan tiles) const;
 
-    Float2D actor_weights;
-    std::vector<double> critic_weights;
+    // Actor-critic(lambda) traces of the previous tiles, one value per
+    // action and one for the critic for each tile
+    double lambda{0};
+    EligibilityTraces<F> traces;
+    void update_traced_weights(const F delta);
 
-    std::vector<double> softmax_prob;
+    void get_softmax_prob(
+        const ActionWeights<S, F>& actor_weights, const TileSpan tiles, F* p);
+    Action agent_policy(const TileSpan tiles);
+
+    ActionWeights<S, F> actor_weights;
+    std::vector<S> critic_weights;
+
+    std::array<F, max_actions> softmax_prob{};
 
 };
+
+using ActorCriticAgent = ActorCriticAgentT<WeightStorage, WeightMath>;
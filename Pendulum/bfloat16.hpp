@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace rl {
+namespace agent {
+
+// 16 bit storage for weights: the upper half of a float, so it keeps the
+// float exponent range with 8 bits of precision. Values are converted to
+// float for arithmetic and rounded to nearest even when stored back.
+struct bfloat16
+{
+    std::uint16_t bits{0};
+
+    bfloat16() = default;
+    bfloat16(const float value)
+    {
+        std::uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7fffffff) > 0x7f800000)
+            bits = static_cast<std::uint16_t>((u >> 16) | 0x40);  // keep NaN quiet
+        else
+            bits = static_cast<std::uint16_t>((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+    }
+
+    operator float() const
+    {
+        const std::uint32_t u = std::uint32_t{bits} << 16;
+        float value;
+        std::memcpy(&value, &u, sizeof(value));
+        return value;
+    }
+
+    bfloat16& operator+=(const float delta) { return *this = bfloat16(float(*this) + delta); }
+};
+
+} // agent
+} // rl
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace rl {
+namespace agent {
+
+// How a trace is refreshed when its key is active again
+//   Accumulating - the new gradient is added to the trace
+//   Replacing    - the new gradient replaces the trace
+enum class TraceType { Accumulating, Replacing };
+
+// Eligibility traces that hold only the keys with a nonzero trace, each with
+// width values (e.g. one per action of a tile). Decaying, applying and
+// clearing the traces cost O(active traces). Finding the trace of a key goes
+// through a small open addressing map from key to entry, kept at most half
+// full and grown with the active traces, so the memory of the traces is
+// O(most traces active at once) however many keys there are.
+template <class F>
+class EligibilityTraces
+{
+public:
+    /* Empties the traces and allows keys [0, num_keys) */
+    void resize(const std::size_t num_keys, const std::size_t width,
+                const TraceType type, const F threshold)
+    {
+        this->num_keys = num_keys;
+        this->width = width;
+        this->type = type;
+        this->threshold = threshold;
+        keys.clear();
+        values.clear();
+        rehash(min_slots);
+    }
+
+    void clear()
+    {
+        // With every key gone no probe chain needs to survive
+        for (auto key : keys)
+            slots[find(key)] = Slot{};
+        keys.clear();
+        values.clear();
+    }
+
+    /* Refreshes the trace of key with width gradient values */
+    void add(const std::uint32_t key, const F* gradient)
+    {
+        const std::size_t slot = find(key);
+        const std::uint32_t entry = slots[slot].entry;
+        if (entry == 0)
+        {
+            if (key >= num_keys)
+                throw std::out_of_range("EligibilityTraces: key out of range");
+            keys.push_back(key);
+            values.insert(values.end(), gradient, gradient + width);
+            slots[slot] = Slot{key, static_cast<std::uint32_t>(keys.size())};
+            if (2 * keys.size() > slots.size())
+                rehash(2 * slots.size());
+            return;
+        }
+
+        F* z = values.data() + (entry - 1) * width;
+        if (type == TraceType::Replacing)
+            std::copy(gradient, gradient + width, z);
+        else
+            for (std::size_t i = 0; i < width; ++i)
+                z[i] += gradient[i];
+    }
+
+    /* z *= factor, dropping the traces whose values all fall below the
+     * threshold in magnitude */
+    void decay(const F factor)
+    {
+        std::size_t i = 0;
+        while (i < keys.size())
+        {
+            F* z = values.data() + i * width;
+            F largest = 0;
+            for (std::size_t k = 0; k < width; ++k)
+            {
+                z[k] *= factor;
+                largest = std::max(largest, std::abs(z[k]));
+            }
+
+            if (largest >= threshold)
+            {
+                ++i;
+                continue;
+            }
+
+            // Move the last trace into this entry
+            erase(keys[i]);
+            const std::size_t last = keys.size() - 1;
+            if (i != last)
+            {
+                keys[i] = keys[last];
+                std::copy(values.data() + last * width, values.data() + (last + 1) * width, z);
+                slots[find(keys[i])].entry = static_cast<std::uint32_t>(i + 1);
+            }
+            keys.pop_back();
+            values.resize(last * width);
+        }
+    }
+
+    std::size_t size() const { return keys.size(); }
+    std::uint32_t key(const std::size_t i) const { return keys[i]; }
+    const F* trace(const std::size_t i) const { return values.data() + i * width; }
+    // Slots of the key to entry map, at least twice the most active traces
+    std::size_t map_capacity() const { return slots.size(); }
+
+private:
+    struct Slot
+    {
+        std::uint32_t key{0};
+        std::uint32_t entry{0};  // 1 + position of the key's trace, 0 if the slot is empty
+    };
+
+    static constexpr std::size_t min_slots = 16;
+
+    std::size_t num_keys{0};
+    std::size_t width{1};
+    TraceType type{TraceType::Accumulating};
+    F threshold{0};
+    std::vector<std::uint32_t> keys;     // key of each active trace
+    std::vector<F> values;               // width values per active trace
+    std::vector<Slot> slots;             // a power of two of them
+    std::size_t mask{0};
+    unsigned int shift{0};
+
+    /* Fibonacci hashing; tile indices are small and dense, so the top bits of
+     * the product spread them over the slots */
+    std::size_t home(const std::uint32_t key) const
+    {
+        return static_cast<std::size_t>((std::uint64_t{key} * 0x9e3779b97f4a7c15ULL) >> shift);
+    }
+
+    /* The slot of key, or the empty slot where it would go */
+    std::size_t find(const std::uint32_t key) const
+    {
+        std::size_t i = home(key);
+        while (slots[i].entry != 0 && slots[i].key != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    /* Removes key, shifting back the slots after it that probed past it so
+     * that no tombstones are left */
+    void erase(const std::uint32_t key)
+    {
+        std::size_t hole = find(key);
+        for (std::size_t i = (hole + 1) & mask; slots[i].entry != 0; i = (i + 1) & mask)
+        {
+            // Move slot i into the hole unless its home lies between them
+            if (((i - home(slots[i].key)) & mask) >= ((i - hole) & mask))
+            {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = Slot{};
+    }
+
+    void rehash(const std::size_t num_slots)
+    {
+        slots.assign(num_slots, Slot{});
+        mask = num_slots - 1;
+        shift = 64;
+        for (std::size_t n = num_slots; n > 1; n >>= 1)
+            --shift;
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            slots[find(keys[i])] = Slot{keys[i], static_cast<std::uint32_t>(i + 1)};
+    }
+};
+
+} // agent
+} // rl
@@ -1,16 +1,19 @@
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdio>
-#include <fstream>
 #include <map>
 #include <memory>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <vector>
 
 #include "rl.hpp"
+#include "result_file.hpp"
+#include "sweep.hpp"
 #include "pendulum_env.hpp"
 #include "actor_critic_agent.hpp"
 
@@ -18,16 +21,26 @@ using namespace rl;
 using namespace env;
 using namespace agent;
 
-
-int main()
+/* Runs the study of a sweep config, by default pendulum_sweep.cfg:
+ *
+ *     Pendulum [config [worker | merge queue_dir]]
+ *
+ * Each cell records the return and the exponential average reward after
+ * every step; results.bin gets both, a row per run of each config. As a
+ * worker it runs the cells no other worker on queue_dir has claimed; merge
+ * collects the cells of the workers and writes results.bin.
+ */
+int main(int argc, char* argv[])
 {
-    constexpr unsigned int num_runs = 25;
-    constexpr unsigned int max_steps = 20000;
-
-    std::shared_ptr<Agent> agent = std::make_shared<ActorCriticAgent>();
-    std::shared_ptr<Environment> env = std::make_shared<PendulumEnvironment>();
+    const std::string mode = argc == 4 ? argv[2] : "";
+    if (argc > 4 || argc == 3 || (argc == 4 && mode != "worker" && mode != "merge"))
+    {
+        std::fprintf(stderr, "usage: %s [config [worker | merge queue_dir]]\n", argv[0]);
+        return 1;
+    }
 
-    constexpr double step_size = 0.5;
+    // Defaults for the fields the config leaves out; run r of a config draws
+    // stream r of the seeds, wherever it runs
     EnvironmentInit env_params = {0, true};
 
     AgentInit agent_params;
@@ -41,23 +54,29 @@ int main()
     agent_params.seed = 0;
     agent_params.use_seed = true;
 
-    std::array<std::array<double, max_steps>, num_runs> returns;
-    std::array<std::array<double, max_steps>, num_runs> exp_avg_rewards;
-
-    auto gen = std::mt19937(std::random_device{}());
-    auto rand_int = std::uniform_int_distribution<>(0);
-
-    auto tic = std::chrono::steady_clock::now();
-
-    RL rl(env, agent);
-    for (unsigned int run=0; run < num_runs; ++run)
+    // Actor and critic step sizes the config leaves out are scaled by its
+    // own tilings
+    auto agent_defaults = [](AgentInit& params, const Sweep::Config& config)
     {
-        env_params.seed = rand_int(gen);
-        agent_params.seed = rand_int(gen);
-
-        rl.rl_init(env_params, agent_params);
+        if (Sweep::get_value(config, "actor_step_size", "").empty())
+            params.actor_step_size = 0.25 / params.num_tilings;
+        if (Sweep::get_value(config, "critic_step_size", "").empty())
+            params.critic_step_size = 2.0 / params.num_tilings;
+    };
+    // The only setting run_cell reads; any other name must be an AgentInit field
+    const std::vector<std::string> settings = {"num_steps"};
+    Sweep sweep(argc > 1 ? argv[1] : PENDULUM_SWEEP_FILE, env_params, agent_params, settings, agent_defaults);
+    const unsigned int num_runs = sweep.get_num_runs();
+
+    auto make_env = []() { return std::make_shared<PendulumEnvironment>(); };
+    auto make_agent = []() { return std::make_shared<ActorCriticAgent>(); };
+    auto run_cell = [](RL& rl, const Sweep::Config& config, const unsigned int)
+    {
+        const unsigned int max_steps = std::stoul(Sweep::get_value(config, "num_steps", "20000"));
         rl.rl_start();
 
+        // the returns, then the exponential average rewards
+        std::vector<double> results(2 * max_steps);
         double total_return{0};
 
         // exponential average reward without initial bias
@@ -76,33 +95,66 @@ int main()
             auto ss = exp_avg_reward_ss / exp_avg_reward_normalizer;
             exp_avg_reward += ss * (obs.reward - exp_avg_reward);
 
-            returns[run][step] = total_return;
-            exp_avg_rewards[run][step] = exp_avg_reward;
+            results[step] = total_return;
+            results[max_steps + step] = exp_avg_reward;
         }
-    }
-
-    auto toc = std::chrono::steady_clock::now();
-    std::chrono::duration<double> diff = toc - tic;
-    std::printf("step_size: %4.3f, num_tilings: %d, num_tiles: %d, %5.2f it/s, %6.5f s/it, (elapsed %f s)\n",
-            agent_params.step_size, agent_params.num_tilings, agent_params.num_tiles,
-            (num_runs*max_steps)/diff.count(), diff.count()/(num_runs*max_steps), diff.count());
-
-    std::ofstream fout;
-    fout.open ("returns.txt");
-
-    for (unsigned int run=0; run < num_runs; ++run)
-        for (unsigned int step=0; step < max_steps; ++step)
-            fout << returns[run][step] << std::endl;
-
-    fout.close();
-
-    fout.open ("exp_avg_rewards.txt");
+        return results;
+    };
 
-    for (unsigned int run=0; run < num_runs; ++run)
-        for (unsigned int step=0; step < max_steps; ++step)
-            fout << exp_avg_rewards[run][step] << std::endl;
-
-    fout.close();
+    auto tic = std::chrono::steady_clock::now();
+    if (mode == "worker")
+    {
+        std::size_t num_cells = sweep.run_worker(argv[3], make_env, make_agent, run_cell);
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+        std::printf("%zu cells run, (elapsed %f s)\n", num_cells, diff.count());
+        return 0;
+    }
+    else if (mode == "merge")
+    {
+        std::size_t num_missing = sweep.merge(argv[3]);
+        if (num_missing != 0)
+        {
+            std::fprintf(stderr, "%zu cells are not done yet\n", num_missing);
+            return 1;
+        }
+    }
+    else
+    {
+        std::size_t num_cells = sweep.run(make_env, make_agent, run_cell);
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+        std::printf("%zu cells run, %zu read from %s, %5.2f it/s, (elapsed %f s)\n",
+                num_cells, sweep.get_num_configs() * num_runs - num_cells, sweep.get_results_path().c_str(),
+                num_cells/diff.count(), diff.count());
+    }
 
+    // results.bin: the returns and the exponential average rewards of every
+    // run of every config, padded with NaN past the steps of shorter configs,
+    // the configs in the header, see result_file.hpp
+    std::size_t num_steps = 0;
+    for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
+        num_steps = std::max(num_steps, sweep.get_result(config, 0).size() / 2);
+
+    const std::size_t num_rows = sweep.get_num_configs() * num_runs;
+    std::vector<double> returns(num_rows * num_steps, std::numeric_limits<double>::quiet_NaN());
+    std::vector<double> exp_avg_rewards(num_rows * num_steps, std::numeric_limits<double>::quiet_NaN());
+    ResultFile results_file;
+    results_file.set_config("num_runs", std::to_string(num_runs));
+    for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
+    {
+        for (unsigned int run=0; run < num_runs; ++run)
+        {
+            const std::vector<double>& results = sweep.get_result(config, run);
+            const std::size_t max_steps = results.size() / 2;
+            const std::size_t row = (config * num_runs + run) * num_steps;
+            std::copy(results.cbegin(), results.cbegin() + max_steps, returns.begin() + row);
+            std::copy(results.cbegin() + max_steps, results.cend(), exp_avg_rewards.begin() + row);
+        }
+        std::string params;
+        for (const auto& param : sweep.get_config(config))
+            params += (params.empty() ? "" : ", ") + param.first + ": " + param.second;
+        results_file.set_config("config_" + std::to_string(config), params);
+    }
+    results_file.add_column("returns", {sweep.get_num_configs(), num_runs, num_steps}, returns.data());
+    results_file.add_column("exp_avg_rewards", {sweep.get_num_configs(), num_runs, num_steps}, exp_avg_rewards.data());
+    results_file.write("results.bin");
 }
-
@@ -0,0 +1,96 @@
+#include "pendulum_batch_env.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace rl;
+using namespace env;
+
+// Out of line definitions of the constants, which are odr-used below
+constexpr double PendulumBatchEnv::pi;
+constexpr double PendulumBatchEnv::dt;
+constexpr double PendulumBatchEnv::gravity;
+constexpr double PendulumBatchEnv::mass;
+constexpr double PendulumBatchEnv::length;
+
+void PendulumBatchEnv::env_init(const std::size_t num_pendulums)
+{
+    angles.assign(num_pendulums, -pi);
+    velocities.assign(num_pendulums, 0);
+    rewards.assign(num_pendulums, 0);
+    reset_mask.assign((num_pendulums + 31) / 32, 0);
+}
+
+void PendulumBatchEnv::env_start()
+{
+    std::fill(angles.begin(), angles.end(), -pi);
+    std::fill(velocities.begin(), velocities.end(), 0.0);
+    std::fill(rewards.begin(), rewards.end(), 0.0);
+    std::fill(reset_mask.begin(), reset_mask.end(), 0);
+}
+
+/* The dynamics of PendulumEnvironment::env_step, operation for operation but
+ * for the sine, with the angle wrapped into [-pi, pi) by the same floor based
+ * modulo. The angle is already wrapped when the reward -|angle| is taken, so
+ * it is not wrapped a second time.
+ */
+void PendulumBatchEnv::env_step(const Action* actions)
+{
+    constexpr double two_pi = 2 * pi;
+    constexpr double torque_scale = mass * length * gravity;
+    constexpr double inertia = mass * length * length;
+
+    std::fill(reset_mask.begin(), reset_mask.end(), 0);
+
+    std::size_t i = 0;
+#ifdef __AVX2__
+    const __m256d vpi = _mm256_set1_pd(pi), vtwo_pi = _mm256_set1_pd(two_pi);
+    const __m256d vdt = _mm256_set1_pd(dt);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    for (; i + 4 <= size(); i += 4)
+    {
+        __m256d action = _mm256_sub_pd(_mm256_cvtepi32_pd(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(actions + i))), _mm256_set1_pd(1.0));
+        __m256d angle = _mm256_loadu_pd(angles.data() + i);
+        __m256d velocity = _mm256_loadu_pd(velocities.data() + i);
+
+        __m256d torque = _mm256_add_pd(action, _mm256_mul_pd(_mm256_set1_pd(torque_scale), sin_approx(angle)));
+        __m256d accel = _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(0.75), torque), _mm256_set1_pd(inertia));
+        velocity = _mm256_add_pd(velocity, _mm256_mul_pd(accel, vdt));
+
+        angle = _mm256_add_pd(_mm256_add_pd(angle, _mm256_mul_pd(velocity, vdt)), vpi);
+        angle = _mm256_sub_pd(angle, _mm256_mul_pd(_mm256_floor_pd(_mm256_div_pd(angle, vtwo_pi)), vtwo_pi));
+        angle = _mm256_sub_pd(angle, vpi);
+
+        __m256d reset = _mm256_cmp_pd(_mm256_andnot_pd(sign, velocity), vtwo_pi, _CMP_GT_OQ);
+        angle = _mm256_blendv_pd(angle, _mm256_sub_pd(_mm256_setzero_pd(), vpi), reset);
+        velocity = _mm256_blendv_pd(velocity, _mm256_setzero_pd(), reset);
+
+        _mm256_storeu_pd(angles.data() + i, angle);
+        _mm256_storeu_pd(velocities.data() + i, velocity);
+        _mm256_storeu_pd(rewards.data() + i, _mm256_or_pd(sign, angle));
+        reset_mask[i / 32] |= static_cast<std::uint32_t>(_mm256_movemask_pd(reset)) << (i % 32);
+    }
+#endif
+    for (; i < size(); ++i)
+    {
+        double angle = angles[i];
+        double velocity = velocities[i];
+
+        double torque = (actions[i] - 1.0) + torque_scale * sin_approx(angle);
+        velocity += 0.75 * torque / inertia * dt;
+
+        angle = (angle + velocity * dt) + pi;
+        angle = angle - std::floor(angle / two_pi) * two_pi;
+        angle = angle - pi;
+
+        const bool reset = std::abs(velocity) > two_pi;
+        angle = reset ? -pi : angle;
+        velocity = reset ? 0.0 : velocity;
+
+        angles[i] = angle;
+        velocities[i] = velocity;
+        rewards[i] = -std::abs(angle);
+        reset_mask[i / 32] |= std::uint32_t{reset} << (i % 32);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rl_env.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace rl;
+using namespace env;
+
+/* sin(x) for |x| <= pi, to within a few double ulps: x is folded onto
+ * [-pi / 2, pi / 2] with sin(x) = sin(+-pi - x) and the Taylor series summed
+ * to the x^19 term. The AVX2 version makes the same operations in the same
+ * order, so both give the same bits.
+ */
+inline double sin_approx(double x)
+{
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double half_pi = 1.57079632679489661923;
+
+    const double half_turn = (x < 0.0) ? -pi : pi;
+    const double folded = half_turn - x;
+    x = (std::abs(x) > half_pi) ? folded : x;
+
+    const double x2 = x * x;
+    double s = -1.0 / 121645100408832000.0;
+    s = s * x2 + 1.0 / 355687428096000.0;
+    s = s * x2 - 1.0 / 1307674368000.0;
+    s = s * x2 + 1.0 / 6227020800.0;
+    s = s * x2 - 1.0 / 39916800.0;
+    s = s * x2 + 1.0 / 362880.0;
+    s = s * x2 - 1.0 / 5040.0;
+    s = s * x2 + 1.0 / 120.0;
+    s = s * x2 - 1.0 / 6.0;
+    s = s * x2 + 1.0;
+    return s * x;
+}
+
+#ifdef __AVX2__
+inline __m256d sin_approx(__m256d x)
+{
+    const __m256d pi = _mm256_set1_pd(3.14159265358979323846);
+    const __m256d half_pi = _mm256_set1_pd(1.57079632679489661923);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+
+    __m256d half_turn = _mm256_or_pd(pi, _mm256_and_pd(x, sign));
+    __m256d fold = _mm256_cmp_pd(_mm256_andnot_pd(sign, x), half_pi, _CMP_GT_OQ);
+    x = _mm256_blendv_pd(x, _mm256_sub_pd(half_turn, x), fold);
+
+    const __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d s = _mm256_set1_pd(-1.0 / 121645100408832000.0);
+    s = _mm256_add_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 355687428096000.0));
+    s = _mm256_sub_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 1307674368000.0));
+    s = _mm256_add_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 6227020800.0));
+    s = _mm256_sub_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 39916800.0));
+    s = _mm256_add_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 362880.0));
+    s = _mm256_sub_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 5040.0));
+    s = _mm256_add_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 120.0));
+    s = _mm256_sub_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0 / 6.0));
+    s = _mm256_add_pd(_mm256_mul_pd(s, x2), _mm256_set1_pd(1.0));
+    return _mm256_mul_pd(s, x);
+}
+#endif
+
+/* Pendulums stepped many at a time, held as structure of arrays so that a
+ * step advances four pendulums per AVX2 instruction, without branches. The
+ * dynamics are those of PendulumEnvironment; a pendulum whose velocity leaves
+ * [-2 pi, 2 pi] is put back at rest, hanging down, and its bit set in the
+ * reset mask.
+ */
+class PendulumBatchEnv
+{
+public:
+    void env_init(const std::size_t num_pendulums);
+    // Starts every pendulum at rest, hanging down
+    void env_start();
+    // Steps every pendulum i with actions[i]
+    void env_step(const Action* actions);
+
+    std::size_t size() const { return angles.size(); }
+    State get_state(const std::size_t i) const { return {angles[i], velocities[i]}; }
+    void set_state(const std::size_t i, const State state)
+    {
+        angles[i] = state.angle;
+        velocities[i] = state.velocity;
+    }
+    const double* get_angles() const { return angles.data(); }
+    const double* get_velocities() const { return velocities.data(); }
+    const double* get_rewards() const { return rewards.data(); }
+    // Bit i % 32 of word i / 32 is set when pendulum i was reset
+    const std::uint32_t* get_reset_mask() const { return reset_mask.data(); }
+    bool is_reset(const std::size_t i) const { return (reset_mask[i / 32] >> (i % 32)) & 1; }
+
+    static constexpr double pi = 3.14159265358979323846;
+    static constexpr double dt = 0.05;
+    static constexpr double gravity = 9.8;
+    static constexpr double mass = 1.0 / 3.0;
+    static constexpr double length = 3.0 / 2.0;
+
+private:
+    std::vector<double> angles;
+    std::vector<double> velocities;
+    std::vector<double> rewards;
+    std::vector<std::uint32_t> reset_mask;
+};
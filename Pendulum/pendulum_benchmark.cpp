@@ -0,0 +1,81 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "rl.hpp"
+#include "pendulum_env.hpp"
+#include "actor_critic_agent.hpp"
+
+using namespace rl;
+using namespace env;
+using namespace agent;
+
+/* Steps per second of num_runs runs of num_steps steps through rl */
+template <class Loop>
+double steps_per_second(Loop& rl, EnvironmentInit env_params, AgentInit agent_params,
+                        const unsigned int num_runs, const unsigned int num_steps)
+{
+    auto tic = std::chrono::steady_clock::now();
+    for (unsigned int run=0; run < num_runs; ++run)
+    {
+        env_params.run = run;
+        agent_params.run = run;
+        rl.rl_init(env_params, agent_params);
+        rl.rl_start();
+        for (unsigned int step=0; step < num_steps; ++step)
+            rl.rl_step();
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - tic;
+    return (num_runs * num_steps) / diff.count();
+}
+
+/* Times the same seeded runs of the actor-critic agent with 32 tilings of
+ * 8 x 8 tiles through RL, which calls the agent and the environment through
+ * their virtual interfaces, and through StaticRL, which binds them at compile
+ * time. The two are timed in turn, and the best of the repeats of each is
+ * reported:
+ *
+ *     PendulumBenchmark [num_runs [num_steps [num_repeats]]]
+ */
+int main(int argc, char* argv[])
+{
+    if (argc > 4)
+    {
+        std::fprintf(stderr, "usage: %s [num_runs [num_steps [num_repeats]]]\n", argv[0]);
+        return 1;
+    }
+    const unsigned int num_runs = argc > 1 ? std::stoul(argv[1]) : 5;
+    const unsigned int num_steps = argc > 2 ? std::stoul(argv[2]) : 20000;
+    const unsigned int num_repeats = argc > 3 ? std::stoul(argv[3]) : 5;
+
+    EnvironmentInit env_params = {0, true};
+
+    AgentInit agent_params;
+    agent_params.num_actions = 3;
+    agent_params.index_hash_table_size = 4096;
+    agent_params.num_tilings = 32;
+    agent_params.num_tiles = 8;
+    agent_params.actor_step_size = 0.25 / agent_params.num_tilings;
+    agent_params.critic_step_size = 2.0 / agent_params.num_tilings;
+    agent_params.avg_reward_step_size = std::pow(2, -6);
+    agent_params.use_seed = true;
+
+    std::shared_ptr<Agent> agent = std::make_shared<ActorCriticAgent>();
+    std::shared_ptr<Environment> env = std::make_shared<PendulumEnvironment>();
+    RL virtual_rl(env, agent);
+    StaticRL<PendulumEnvironment, ActorCriticAgent> static_rl;
+    double virtual_rate{0}, static_rate{0};
+    for (unsigned int repeat=0; repeat < num_repeats; ++repeat)
+    {
+        virtual_rate = std::max(virtual_rate,
+                steps_per_second(virtual_rl, env_params, agent_params, num_runs, num_steps));
+        static_rate = std::max(static_rate,
+                steps_per_second(static_rl, env_params, agent_params, num_runs, num_steps));
+    }
+    std::printf("%u runs of %u steps, best of %u: RL %.0f steps/s, StaticRL %.0f steps/s (%.2fx)\n",
+            num_runs, num_steps, num_repeats, virtual_rate, static_rate, static_rate / virtual_rate);
+}
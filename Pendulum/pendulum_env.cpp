@@ -3,7 +3,6 @@
 
 #include <cassert>
 #include <cmath>
-#include <type_traits>
 
 using namespace rl;
 using namespace env;
@@ -38,8 +37,10 @@ using namespace env;
  */
 void PendulumEnvironment::env_init(const EnvironmentInit params)
 {
-    if (std::is_empty<EnvironmentInit>::value)
-        (void)params;
+    if (params.use_seed)
+        gen = rng::make_engine(params.seed, params.run, rng::env_stream);
+    else
+        gen = rng::make_engine(std::random_device{}());
 
     dt = 0.05;
 
@@ -4,6 +4,7 @@
 #include <random>
 #include <vector>
 
+#include "rng.hpp"
 #include "rl_env.hpp"
 
 using namespace rl;
@@ -26,8 +27,7 @@ private:
     Action last_action{};
     Observation observation;
 
-    std::mt19937 gen;
-    std::uniform_real_distribution<> rand_real;
+    rng::Engine gen;
 
     double dt{};
     static constexpr double pi = 4 * std::atan(1);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <array>
 #include <limits>
 #include "tc.hpp"
 
@@ -8,31 +9,110 @@ using namespace tc;
 
 namespace pendulum_tc {
 
-class PendulumTileCoder : TileCoder
+class PendulumTileCoder
 {
 public:
     static constexpr float pi = 4 * std::atan(1);
 
-    PendulumTileCoder() : TileCoder() {};
+    PendulumTileCoder() {};
     ~PendulumTileCoder() {};
 
-    void initialize(const std::size_t capacity, const std::uint32_t _num_tilings, const std::uint32_t _num_tiles)
+    /* With TileIndexing::Dense the tiles are indexed directly and capacity
+     * only bounds the number of indices, which depends on num_tilings and
+     * num_tiles alone.
+     */
+    void initialize(const std::size_t capacity, const std::uint32_t _num_tilings, const std::uint32_t _num_tiles,
+                    const OverflowPolicy overflow_policy = OverflowPolicy::Throw,
+                    const TileIndexing _indexing = TileIndexing::Hashed)
     {
       tc.clear();
-      tc.set_capacity(capacity);
       num_tilings = _num_tilings;
       num_tiles = _num_tiles;
+      indexing = _indexing;
+
+      // The hash table is only sized when it is used
+      tc.share_table(nullptr);
+      tc.set_overflow_policy(overflow_policy);
+      tc.set_capacity(indexing == TileIndexing::Hashed ? capacity : 0);
+
+      if (indexing == TileIndexing::Dense)
+      {
+        dense_tc.initialize(num_tilings, {num_tiles, num_tiles}, {num_tiles, 0});
+        if (dense_tc.get_size() > capacity)
+            throw(std::out_of_range("Dense tile coder needs more indices than capacity"));
+      }
     }
 
     /* Takes in an angle and angular velocity from the pendulum environment
-     * and returns a vector of active tiles.
+     * and writes the active tiles into a caller owned buffer.
      * Arguments:
      *   angle -- float, the angle of the pendulum between -pi and pi
      *   velocity -- float, the angular velocity of the pendulum between -2pi and 2pi 
-     * Returns:
+     *   tiles -- buffer receiving num_tilings active tiles
+     */
+    void get_tiles(const float angle, const float velocity, Tiles& tiles)
+    {
+        TileCoder<2>::Floats floats = scale(angle, velocity);
+
+        if (indexing == TileIndexing::Dense)
+            return dense_tc.get_tiles(floats, tiles);
+
+        // Get tiles by calling get_tileswrap method
+        // wrap_widths specify which dimension to wrap over and its wrap_width
+        const TileCoder<2>::WrapWidths wrap_widths{num_tiles, 0};
+        tc.get_tileswrap(num_tilings, floats, wrap_widths, tiles);
+    }
+
+    /* Returns:
      *   tiles - vector of active tiles
      */
     std::vector<std::uint32_t> get_tiles(const float angle, const float velocity)
+    {
+        Tiles tiles;
+        get_tiles(angle, velocity, tiles);
+        return std::vector<std::uint32_t>(tiles.begin(), tiles.end());
+    }
+
+    /* Codes n states at once, writing an n x num_tilings row major matrix
+     * of active tiles to tiles, row i for (angles[i], velocities[i]).
+     */
+    void get_tiles(const float* angles, const float* velocities, const std::size_t n, std::uint32_t* tiles)
+    {
+        constexpr std::size_t block_size = 256;
+        std::array<float, block_size> angle_scaled, velocity_scaled;
+        for (std::size_t first = 0; first < n; first += block_size)
+        {
+            const std::size_t count = std::min(n - first, block_size);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto floats = scale(angles[first + i], velocities[first + i]);
+                angle_scaled[i] = floats[0];
+                velocity_scaled[i] = floats[1];
+            }
+
+            const TileCoder<2>::FloatArrays floats{angle_scaled.data(), velocity_scaled.data()};
+            std::uint32_t* block_tiles = tiles + first * num_tilings;
+            if (indexing == TileIndexing::Dense)
+                dense_tc.get_tiles_batch(floats, count, block_tiles);
+            else
+                tc.get_tileswrap_batch(num_tilings, floats, {num_tiles, 0}, count, block_tiles);
+        }
+    }
+
+    // Hashed tiles are looked up in a table shared with other coders, e.g. a
+    // ConcurrentIndexHashTable or a MappedIndexHashTable of a saved table
+    void share_table(std::shared_ptr<TileCoder<2>::SharedTable> table) { tc.share_table(std::move(table)); }
+    void save_table(const std::string& path) const { tc.save_table(path); }
+
+    std::size_t get_collision_count() const { return tc.get_collision_count(); }
+    // Number of indices in use, or all the dense coder can produce
+    std::size_t get_size()
+    {
+        return (indexing == TileIndexing::Dense) ? dense_tc.get_size() : tc.get_size();
+    }
+
+private:
+    TileCoder<2>::Floats scale(const float angle, const float velocity) const
     {
         static constexpr float min_float = std::numeric_limits<float>::epsilon();
 
@@ -41,17 +121,12 @@ public:
         float angle_scaled = (angle - (-pi)) / (pi - (-pi)) * num_tiles + min_float;
         float velocity_scaled = (velocity - (-2*pi)) / (2*pi - (-2*pi)) * num_tiles + min_float;
 
-        std::vector<float> floats = {angle_scaled, velocity_scaled};
-        //std::printf("%f, %f, %f, %f\n", angle, velocity, floats[0], floats[1]);
-
-        // Get tiles by calling get_tileswrap method
-        // wrap_widths specify which dimension to wrap over and its wrap_width
-        const std::vector<std::uint32_t> wrap_widths{num_tiles, 0};
-        return tc.get_tileswrap(num_tilings, floats, wrap_widths);
+        return {angle_scaled, velocity_scaled};
     }
 
-private:
-    TileCoder tc;
+    TileCoder<2> tc;
+    DenseTileCoder<2> dense_tc;
+    TileIndexing indexing{TileIndexing::Hashed};
     std::uint32_t  num_tilings{0};
     std::uint32_t num_tiles{0};
 };
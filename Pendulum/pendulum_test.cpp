@@ -1,14 +1,27 @@
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <random>
+#include <stdexcept>
 
 #include "actor_critic_agent.hpp"
 #include "pendulum_tc.hpp"
 #include "pendulum_env.hpp"
+#include "pendulum_batch_env.hpp"
 #include "rl.hpp"
+#include "result_file.hpp"
+#include "run_executor.hpp"
+#include "sweep.hpp"
 #include "rl_agent.hpp"
 #include "rl_types.hpp"
 
@@ -144,7 +157,7 @@ public:
         using index = Float2D::index;
         for(index j = start_idx; j < start_idx + 10; ++j)
         {
-            std::printf("actor_weights[%d][%lu] = %f\n", action, j, actor_weights[action][j]);
+            std::printf("actor_weights[%d][%lu] = %f\n", action, j, static_cast<double>(actor_weights[action][j]));
         }
     }
 
@@ -152,24 +165,75 @@ public:
     {
         for(unsigned int j = start_idx; j < start_idx + 10; ++j)
         {
-            std::printf("critic_weights[%d] = %f\n", j, critic_weights[j]);
+            std::printf("critic_weights[%d] = %f\n", j, static_cast<double>(critic_weights[j]));
         }
     }
 
-    std::vector<double> get_critic_weights() { return critic_weights; }
+    std::vector<double> get_critic_weights()
+    {
+        return std::vector<double>(critic_weights.begin(), critic_weights.end());
+    }
 
     std::vector<double> return_softmax_prob(const std::vector<uint32_t>& tiles)
     {
-        return get_softmax_prob(actor_weights, tiles);
+        decltype(softmax_prob) p{};
+        get_softmax_prob(actor_weights, tiles, p.data());
+        return std::vector<double>(p.begin(), p.begin() + num_actions);
     }
 
     Action get_prev_action() const { return prev_action; }
 
-    std::vector<uint32_t> get_prev_tiles() const { return prev_tiles; }
+    std::vector<uint32_t> get_prev_tiles() const
+    {
+        const auto& prev_tiles = tile_buffers.prev();
+        return std::vector<uint32_t>(prev_tiles.begin(), prev_tiles.end());
+    }
 
     double get_avg_reward() const { return avg_reward; }
+
+    Action pick_tie(const uint32_t ties) { return break_ties(ties); }
+
+    std::vector<double> get_policy() const
+    {
+        return std::vector<double>(softmax_prob.begin(), softmax_prob.begin() + num_actions);
+    }
 };
 
+/* Mean reward over the last quarter of a run of the pendulum experiment */
+template <class AgentType>
+double final_avg_reward(const unsigned int seed)
+{
+    constexpr unsigned int num_steps = 20000;
+    std::shared_ptr<Agent> agent = std::make_shared<AgentType>();
+    std::shared_ptr<Environment> env = std::make_shared<PendulumEnvironment>();
+    EnvironmentInit env_params = {seed, true};
+
+    AgentInit params;
+    params.num_actions = 3;
+    params.index_hash_table_size = 4096;
+    params.num_tilings = 32;
+    params.num_tiles = 8;
+    params.actor_step_size = 0.25 / params.num_tilings;
+    params.critic_step_size = 2.0 / params.num_tilings;
+    params.avg_reward_step_size = std::pow(2, -6);
+    params.seed = seed;
+    params.use_seed = true;
+
+    RL rl(env, agent);
+    rl.rl_init(env_params, params);
+    rl.rl_start();
+
+    double total_reward{0};
+    for (unsigned int step=0; step < num_steps; ++step)
+    {
+        Observation obs;
+        std::tie(obs, std::ignore) = rl.rl_step();
+        if (step >= num_steps - num_steps / 4)
+            total_reward += obs.reward;
+    }
+    return total_reward / (num_steps / 4);
+}
+
 int main()
 {
     std::printf("Pendulum Test\n");
@@ -201,6 +265,183 @@ int main()
         }
     std::printf("Pendulum Tile Coder Test %s\n", pass ? "Passed" : "Failed");
 
+    // 8 tilings fill a 16 entry table after two distinct states
+    pass = true;
+    for (auto policy : { OverflowPolicy::Throw, OverflowPolicy::Fold, OverflowPolicy::HashOnly })
+    {
+        PendulumTileCoder small_tc;
+        small_tc.initialize(16, 8, 8, policy);
+        bool threw = false;
+        try
+        {
+            for (int i=0; i < 8; ++i)
+                for (auto t : small_tc.get_tiles(-pi + i * pi / 4, 0.0))
+                    if (t >= 16)
+                    {
+                        pass = false;
+                        std::printf("test failed!\nindex %u out of range\n", t);
+                    }
+        }
+        catch (const std::out_of_range&)
+        {
+            threw = true;
+        }
+        if (threw != (policy == OverflowPolicy::Throw))
+        {
+            pass = false;
+            std::printf("test failed!\noverflow policy %d %s\n", static_cast<int>(policy),
+                    threw ? "threw" : "did not throw");
+        }
+        if (policy != OverflowPolicy::Throw && small_tc.get_collision_count() == 0)
+        {
+            pass = false;
+            std::printf("test failed!\noverflow policy %d counted no collisions\n", static_cast<int>(policy));
+        }
+    }
+    std::printf("Pendulum Tile Coder Overflow Test %s\n", pass ? "Passed" : "Failed");
+
+    // With odd displacements and a power of two number of tilings, moving one
+    // dimension by 1/num_tilings of a tile changes the tile in exactly one tiling
+    pass = true;
+    {
+        TileCoder<4> tc4(4096);
+        TileCoder<4>::Floats x{0.5, 1.25, 2.0, 3.0};
+        auto tiles1 = tc4.get_tiles(8, x);
+        auto tiles2 = tc4.get_tiles(8, x);
+        if (!compare_vec<uint32_t>(tiles1, tiles2) ||
+            !compare_vec<uint32_t>(tiles1, std::vector<uint32_t>{0, 1, 2, 3, 4, 5, 6, 7}))
+        {
+            pass = false;
+            std::printf("test failed!\nexpected: 0 1 2 3 4 5 6 7\ninstead of: ");
+            print_vec(tiles2);
+        }
+        for (std::size_t d = 0; d < 4; ++d)
+        {
+            auto y = x;
+            y[d] += 1.0 / 8;
+            auto tiles3 = tc4.get_tiles(8, y);
+            int changed = 0;
+            for (std::size_t j = 0; j < tiles1.size(); ++j)
+                changed += (tiles1[j] != tiles3[j]);
+            if (changed != 1)
+            {
+                pass = false;
+                std::printf("test failed!\ndimension %lu changed %d tilings\n", d, changed);
+            }
+        }
+    }
+    std::printf("Pendulum N-d Tile Coder Test %s\n", pass ? "Passed" : "Failed");
+
+    // The dense coder must produce the same tiles as the hashed one, only
+    // numbered differently, and stay within its (8 tilings x 8 x 10) indices
+    pass = true;
+    {
+        PendulumTileCoder hashed_tc, dense_tc;
+        hashed_tc.initialize(4096, 8, 8);
+        dense_tc.initialize(4096, 8, 8, OverflowPolicy::Throw, TileIndexing::Dense);
+        if (dense_tc.get_size() != 8 * 8 * 10)
+        {
+            pass = false;
+            std::printf("test failed!\ndense size %lu instead of %d\n", dense_tc.get_size(), 8 * 8 * 10);
+        }
+
+        std::map<uint32_t, uint32_t> to_dense, to_hashed;
+        for (int i=0; i <= 40; ++i)
+            for (int j=0; j <= 40; ++j)
+            {
+                double angle = -pi + (i * 2*pi) / 40;
+                double velocity = - 2*pi + (j * 4*pi) / 40;
+                auto tiles = hashed_tc.get_tiles(angle, velocity);
+                auto dense_tiles = dense_tc.get_tiles(angle, velocity);
+                for (std::size_t k=0; k < tiles.size(); ++k)
+                {
+                    auto h = to_dense.emplace(tiles[k], dense_tiles[k]).first;
+                    auto d = to_hashed.emplace(dense_tiles[k], tiles[k]).first;
+                    if (h->second != dense_tiles[k] || d->second != tiles[k] ||
+                        dense_tiles[k] >= dense_tc.get_size())
+                    {
+                        pass = false;
+                        std::printf("test failed!\n(%f, %f) tiling %lu: hashed %u, dense %u\n",
+                                angle, velocity, k, tiles[k], dense_tiles[k]);
+                    }
+                }
+            }
+    }
+    std::printf("Pendulum Dense Tile Coder Test %s\n", pass ? "Passed" : "Failed");
+
+    // Multiply-shift division and the coordinate kernels against plain division
+    pass = true;
+    {
+        std::mt19937 gen(0);
+        std::vector<uint32_t> numerators = { 0, 1, 2, 7, 8, 63, 64, 65, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff };
+        for (int i=0; i < 1000; ++i)
+            numerators.push_back(gen());
+
+        for (uint32_t d : { 1u, 2u, 3u, 5u, 7u, 8u, 13u, 32u, 64u, 100u, 0x80000001u, 0xffffffffu })
+        {
+            Divider div(d);
+            for (auto n : numerators)
+                if (div.divide(n) != n / d || div.modulo(n) != n % d)
+                {
+                    pass = false;
+                    std::printf("test failed!\n%u / %u gave %u\n", n, d, div.divide(n));
+                }
+        }
+
+        for (uint32_t nt : { 1u, 3u, 8u, 13u, 32u })
+        {
+            Divider div(nt), wrap(5);
+            uint32_t coords[32], coords_wrap[32];
+            for (int q : { -1, 0, 7, 100, 12345 })
+            {
+                tiling_coords(q, 3, 0, nt, div, coords);
+                tiling_coords_wrap(q, 3, 0, nt, div, &wrap, coords_wrap);
+                for (uint32_t t=0; t < nt; ++t)
+                    if (coords[t] != (q + t * 3) / nt ||
+                        coords_wrap[t] != ((q + (t * 3) % nt) / nt) % 5)
+                    {
+                        pass = false;
+                        std::printf("test failed!\nnum_tilings %u q %d tiling %u\n", nt, q, t);
+                    }
+            }
+        }
+    }
+    std::printf("Pendulum Tile Coder Division Test %s\n", pass ? "Passed" : "Failed");
+
+    // Coding a batch of states gives the indices one call per state would
+    pass = true;
+    for (auto indexing : { TileIndexing::Hashed, TileIndexing::Dense })
+    {
+        const std::size_t n = 500;
+        std::mt19937 gen(0);
+        std::uniform_real_distribution<float> angle_dist(-pi, pi), velocity_dist(-2*pi, 2*pi);
+        std::vector<float> angles(n), velocities(n);
+        for (std::size_t i=0; i < n; ++i)
+        {
+            angles[i] = angle_dist(gen);
+            velocities[i] = velocity_dist(gen);
+        }
+
+        PendulumTileCoder single_tc, batch_tc;
+        single_tc.initialize(4096, 8, 8, OverflowPolicy::Throw, indexing);
+        batch_tc.initialize(4096, 8, 8, OverflowPolicy::Throw, indexing);
+
+        std::vector<uint32_t> batch_tiles(n * 8);
+        batch_tc.get_tiles(angles.data(), velocities.data(), n, batch_tiles.data());
+        for (std::size_t i=0; i < n; ++i)
+        {
+            auto tiles = single_tc.get_tiles(angles[i], velocities[i]);
+            for (std::size_t k=0; k < tiles.size(); ++k)
+                if (tiles[k] != batch_tiles[i * 8 + k])
+                {
+                    pass = false;
+                    std::printf("test failed!\nstate %lu tiling %lu: %u instead of %u\n",
+                            i, k, batch_tiles[i * 8 + k], tiles[k]);
+                }
+        }
+    }
+    std::printf("Pendulum Batch Tile Coder Test %s\n", pass ? "Passed" : "Failed");
+
     pass = true;
     AgentInit params;
     params.num_actions = 3;
@@ -357,6 +598,579 @@ int main()
 
     std::printf("Pendulum rl_step() Test %s\n", pass ? "Passed" : "Failed");
 
+    // Tile major actor weights give the same preferences and updates
+    pass = true;
+    {
+        AgentInit layout_params = params;
+        layout_params.weight_layout = WeightLayout::TileMajor;
+        ActorCriticAgentTest action_major, tile_major;
+        action_major.agent_init(params);
+        tile_major.agent_init(layout_params);
+
+        std::mt19937 state_gen(0);
+        std::uniform_real_distribution<double> angle(-pi, pi), velocity(-2*pi, 2*pi);
+        State state = {angle(state_gen), velocity(state_gen)};
+        Action a1 = action_major.agent_start(state);
+        Action a2 = tile_major.agent_start(state);
+        for (int n=0; n < 500 && a1 == a2; ++n)
+        {
+            state = {angle(state_gen), velocity(state_gen)};
+            a1 = action_major.agent_step(-1.0, state);
+            a2 = tile_major.agent_step(-1.0, state);
+        }
+        if (a1 != a2)
+        {
+            pass = false;
+            std::printf("test failed!\ntile major agent took action %d instead of %d\n", a2, a1);
+        }
+        for (Action a = 0; a < params.num_actions; ++a)
+            if (!compare_vec<double>(action_major.get_actor_weights(a), tile_major.get_actor_weights(a)))
+            {
+                pass = false;
+                std::printf("test failed!\nactor weights of action %d differ\n", a);
+            }
+    }
+    std::printf("Pendulum Weight Layout Test %s\n", pass ? "Passed" : "Failed");
+
+    // The tie mask picks the same action as sampling a list of the ties
+    pass = true;
+    {
+        std::mt19937 value_gen(0), list_gen(1), mask_gen(1);
+        std::uniform_int_distribution<int> level(-3, 0);
+        for (unsigned int n = 1; n <= Agent::max_actions; ++n)
+            for (int trial = 0; trial < 100; ++trial)
+            {
+                std::array<double, Agent::max_actions> q;
+                q.fill(1.0);  // past n, must be ignored
+                for (unsigned int i = 0; i < n; ++i)
+                    q[i] = level(value_gen) * 0.25;
+
+                double top = -HUGE_VAL;
+                std::vector<unsigned int> ties;
+                for (unsigned int i = 0; i < n; ++i)
+                {
+                    if (q[i] > top)
+                    {
+                        top = q[i];
+                        ties.clear();
+                    }
+                    if (q[i] == top)
+                        ties.push_back(i);
+                }
+                std::uniform_int_distribution<> sample(0, ties.size() - 1);
+                unsigned int expected = ties[sample(list_gen)];
+
+                uint32_t mask, float_mask;
+                double mask_top = ties_mask(q.data(), n, mask);
+                std::array<float, Agent::max_actions> float_q;
+                std::copy(q.begin(), q.end(), float_q.begin());
+                if (ties_mask(float_q.data(), n, float_mask) != mask_top || float_mask != mask)
+                {
+                    pass = false;
+                    std::printf("test failed!\n%u actions: float tie mask %x instead of %x\n",
+                            n, float_mask, mask);
+                }
+                std::uniform_int_distribution<> mask_sample(0, __builtin_popcount(mask) - 1);
+                unsigned int actual = select_bit(mask, mask_sample(mask_gen));
+                if (mask_top != top || actual != expected)
+                {
+                    pass = false;
+                    std::printf("test failed!\n%u actions: chose %u (max %f) instead of %u (max %f)\n",
+                            n, actual, mask_top, expected, top);
+                }
+            }
+    }
+
+    // NaN action values never win or tie, in the scalar and AVX2 versions
+    // alike, and when all of them are NaN every action ties
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        std::array<double, Agent::max_actions> q;
+        q.fill(nan);
+        std::array<float, Agent::max_actions> float_q;
+        float_q.fill(nan);
+        uint32_t mask, float_mask;
+        for (unsigned int n : {1u, 5u, 9u, 32u})
+        {
+            if (ties_mask(q.data(), n, mask) != -HUGE_VAL || ties_mask(float_q.data(), n, float_mask) != -HUGE_VALF ||
+                mask != 0 || float_mask != 0)
+            {
+                pass = false;
+                std::printf("test failed!\n%u NaN actions: tie masks %x and %x\n", n, mask, float_mask);
+            }
+        }
+
+        for (unsigned int i = 0; i < 9; ++i)
+            q[i] = float_q[i] = (i % 3 == 1) ? 0.5 : -0.25 * i;
+        q[0] = float_q[0] = nan;
+        q[6] = float_q[6] = nan;
+        const double top = ties_mask(q.data(), 9, mask);
+        const float float_top = ties_mask(float_q.data(), 9, float_mask);
+        const uint32_t expected = (1 << 1) | (1 << 4) | (1 << 7);
+        if (top != 0.5 || float_top != 0.5f || mask != expected || float_mask != expected)
+        {
+            pass = false;
+            std::printf("test failed!\nNaN among the actions: tie masks %x and %x\n", mask, float_mask);
+        }
+
+        ActorCriticAgentTest agent;
+        agent.agent_init(params);
+        std::vector<int> counts(params.num_actions, 0);
+        for (int i = 0; i < 300; ++i)
+        {
+            Action action = agent.pick_tie(0);
+            if (action >= params.num_actions)
+            {
+                pass = false;
+                std::printf("test failed!\nno ties picked action %u\n", action);
+                break;
+            }
+            ++counts[action];
+        }
+        if (*std::min_element(counts.begin(), counts.end()) == 0)
+        {
+            pass = false;
+            std::printf("test failed!\nno ties never picked some action\n");
+        }
+    }
+    std::printf("Pendulum Argmax Test %s\n", pass ? "Passed" : "Failed");
+
+    // The fused step makes the updates of the textbook actor-critic step,
+    // with the policy of the previous state, and with lambda > 0 those of
+    // dense eligibility traces
+    pass = true;
+    for (double lambda : { 0.0, 0.8 })
+    {
+        AgentInit trace_params = params;
+        trace_params.lambda = lambda;
+        trace_params.trace_threshold = 0;
+        ActorCriticAgentTest agent;
+        agent.agent_init(trace_params);
+
+        const std::size_t size = params.index_hash_table_size;
+        std::vector<double> critic_trace(size, 0);
+        std::vector<std::vector<double>> actor_trace(params.num_actions, std::vector<double>(size, 0));
+
+        std::mt19937 state_gen(1);
+        std::uniform_real_distribution<double> angle(-pi, pi), velocity(-2*pi, 2*pi);
+        State state = {angle(state_gen), velocity(state_gen)};
+        agent.agent_start(state);
+        for (int n=0; n < 200 && pass; ++n)
+        {
+            // Small moves, so that consecutive states share tiles
+            state = {std::fmod(state.angle + 0.1 * angle(state_gen), pi),
+                     0.5 * velocity(state_gen)};
+            auto prev_tiles = agent.get_prev_tiles();
+            auto policy = agent.get_policy();
+            Action prev_action = agent.get_prev_action();
+            auto critic = agent.get_critic_weights();
+            std::vector<std::vector<double>> actor;
+            for (Action a = 0; a < params.num_actions; ++a)
+                actor.push_back(agent.get_actor_weights(a));
+            double avg_reward = agent.get_avg_reward();
+
+            agent.agent_step(-1.0, state);
+
+            double vhat = 0, prev_vhat = 0;
+            for (auto t : agent.get_prev_tiles())
+                vhat += critic[t];
+            for (auto t : prev_tiles)
+                prev_vhat += critic[t];
+            double delta = -1.0 - avg_reward + vhat - prev_vhat;
+            for (auto t : prev_tiles)
+            {
+                critic_trace[t] += 1;
+                for (Action a = 0; a < params.num_actions; ++a)
+                    actor_trace[a][t] += (a == prev_action) - policy[a];
+            }
+            for (std::size_t t=0; t < size; ++t)
+            {
+                critic[t] += params.critic_step_size * delta * critic_trace[t];
+                critic_trace[t] *= lambda;
+                for (Action a = 0; a < params.num_actions; ++a)
+                {
+                    actor[a][t] += params.actor_step_size * delta * actor_trace[a][t];
+                    actor_trace[a][t] *= lambda;
+                }
+            }
+
+            if (!compare_vec(critic, agent.get_critic_weights(), 1e-12))
+                pass = false;
+            for (Action a = 0; a < params.num_actions; ++a)
+                if (!compare_vec(actor[a], agent.get_actor_weights(a), 1e-12))
+                    pass = false;
+            if (!pass)
+                std::printf("test failed!\nlambda %g step %d updated weights differ\n", lambda, n);
+        }
+    }
+    std::printf("Pendulum Fused Update Test %s\n", pass ? "Passed" : "Failed");
+
+    // Philox matches its published known answer, the default engine seeds
+    // as before and keyed streams are distinct and in range
+    pass = true;
+    {
+        rng::Philox4x32 philox(0);
+        if (philox() != 0xe169c58d6627e8d5ULL || philox() != 0x9b00dbd8bc57ac4cULL)
+        {
+            pass = false;
+            std::printf("test failed!\nPhilox4x32-10 known answer differs\n");
+        }
+
+        std::mt19937 mt(7);
+        auto keyed_mt = rng::make_engine<std::mt19937>(7);
+        if (mt() != keyed_mt() || rng::make_engine<std::mt19937>(7, 1)() == mt())
+        {
+            pass = false;
+            std::printf("test failed!\nmt19937 keyed seeding differs\n");
+        }
+
+        auto check_engine = [&](auto engine, auto other_run, auto other_stream, const char* name)
+        {
+            if (engine() == other_run() || engine() == other_stream())
+            {
+                pass = false;
+                std::printf("test failed!\n%s streams coincide\n", name);
+            }
+            std::array<unsigned int, 5> counts{};
+            std::array<double, 1000> u;
+            rng::fill_uniform(engine, u.data(), u.size(), -1.0, 1.0);
+            for (double x : u)
+                if (x < -1.0 || x >= 1.0)
+                    pass = false;
+            for (int n = 0; n < 10000; ++n)
+                ++counts.at(rng::uniform_int(engine, 5));
+            for (unsigned int c : counts)
+                if (c < 1800 || c > 2200)
+                {
+                    pass = false;
+                    std::printf("test failed!\n%s uniform_int count %u of 10000 draws\n", name, c);
+                }
+        };
+        check_engine(rng::Xoshiro256(3, 0, 0), rng::Xoshiro256(3, 1, 0), rng::Xoshiro256(3, 0, 1), "xoshiro");
+        check_engine(rng::Philox4x32(3, 0, 0), rng::Philox4x32(3, 1, 0), rng::Philox4x32(3, 0, 1), "philox");
+
+        // The categorical sampler picks what piecewise_constant_distribution did
+        std::mt19937 weight_gen(0), piecewise_gen(5), categorical_gen(5);
+        std::uniform_real_distribution<double> weight(0.0, 1.0);
+        for (unsigned int n = 1; n <= Agent::max_actions; ++n)
+        {
+            std::vector<double> breakpoints(n + 1), w(n);
+            for (unsigned int i = 0; i <= n; ++i)
+                breakpoints[i] = i;
+            for (int trial = 0; trial < 200; ++trial)
+            {
+                for (auto& x : w)
+                    x = weight(weight_gen);
+                std::piecewise_constant_distribution<double> d(breakpoints.begin(), breakpoints.end(), w.begin());
+                unsigned int expected = static_cast<unsigned int>(d(piecewise_gen));
+                unsigned int actual = rng::categorical(categorical_gen, w.data(), n);
+                if (actual != expected)
+                {
+                    pass = false;
+                    std::printf("test failed!\n%u actions: sampled %u instead of %u\n", n, actual, expected);
+                }
+            }
+        }
+    }
+    std::printf("Pendulum RNG Test %s\n", pass ? "Passed" : "Failed");
+
+    // Narrower weights balance the pendulum as well as double weights,
+    // judged by the reward late in a few runs
+    pass = true;
+    {
+        auto mean_reward = [](auto run) {
+            double total{0};
+            for (unsigned int seed=0; seed < 3; ++seed)
+                total += run(seed);
+            return total / 3;
+        };
+        const double baseline = mean_reward(final_avg_reward<ActorCriticAgentT<double, double>>);
+        const std::pair<const char*, double> narrow[] = {
+            {"float", mean_reward(final_avg_reward<ActorCriticAgentT<float, float>>)},
+            {"float/double", mean_reward(final_avg_reward<ActorCriticAgentT<float, double>>)},
+            {"bfloat16/float", mean_reward(final_avg_reward<ActorCriticAgentT<bfloat16, float>>)},
+        };
+        for (const auto& [name, reward] : narrow)
+        {
+            if (std::abs(reward - baseline) > 0.01)
+            {
+                pass = false;
+                std::printf("test failed!\n%s weights averaged %f reward, double weights %f\n",
+                        name, reward, baseline);
+            }
+        }
+    }
+    std::printf("Pendulum Weight Precision Test %s\n", pass ? "Passed" : "Failed");
+
+    // StaticRL takes the same steps as RL does through the virtual
+    // interfaces
+    pass = true;
+    {
+        std::shared_ptr<ActorCriticAgentTest> agent = std::make_shared<ActorCriticAgentTest>();
+        RL virtual_rl(std::make_shared<PendulumEnvironment>(), agent);
+        StaticRL<PendulumEnvironment, ActorCriticAgentTest> static_rl;
+        EnvironmentInit env_init = {0, true};
+        virtual_rl.rl_init(env_init, params);
+        static_rl.rl_init(env_init, params);
+        virtual_rl.rl_start();
+        static_rl.rl_start();
+        for (int step=0; step < 1000 && pass; ++step)
+        {
+            Observation virtual_obs, static_obs;
+            Action virtual_action, static_action;
+            std::tie(virtual_obs, virtual_action) = virtual_rl.rl_step();
+            std::tie(static_obs, static_action) = static_rl.rl_step();
+            if (static_action != virtual_action || static_obs.reward != virtual_obs.reward ||
+                static_rl.get_agent().get_avg_reward() != agent->get_avg_reward())
+            {
+                pass = false;
+                std::printf("test failed!\nstep %d: action %d and reward %f instead of %d and %f\n",
+                        step, static_action, static_obs.reward, virtual_action, virtual_obs.reward);
+            }
+        }
+    }
+    std::printf("Pendulum Static RL Test %s\n", pass ? "Passed" : "Failed");
+
+    // Runs on several threads take the same steps as the same runs one after
+    // another
+    pass = true;
+    {
+        constexpr unsigned int num_runs = 6;
+        constexpr unsigned int num_steps = 2000;
+        EnvironmentInit env_init = {0, true};
+
+        std::array<double, num_runs> parallel_returns{}, serial_returns{};
+        RunExecutor executor([]() { return std::make_shared<PendulumEnvironment>(); },
+                             []() { return std::make_shared<ActorCriticAgent>(); }, 4);
+        executor.run(num_runs, env_init, params, [&](RL& rl, const unsigned int run)
+        {
+            rl.rl_start();
+            for (unsigned int step=0; step < num_steps; ++step)
+                parallel_returns[run] += std::get<0>(rl.rl_step()).reward;
+        });
+
+        StaticRL<PendulumEnvironment, ActorCriticAgent> rl;
+        for (unsigned int run=0; run < num_runs; ++run)
+        {
+            AgentInit run_params = params;
+            env_init.run = run_params.run = run;
+            rl.rl_init(env_init, run_params);
+            rl.rl_start();
+            for (unsigned int step=0; step < num_steps; ++step)
+                serial_returns[run] += std::get<0>(rl.rl_step()).reward;
+        }
+        for (unsigned int run=0; run < num_runs; ++run)
+            if (parallel_returns[run] != serial_returns[run])
+            {
+                pass = false;
+                std::printf("test failed!\nrun %u returned %f in parallel, %f serially\n",
+                        run, parallel_returns[run], serial_returns[run]);
+            }
+    }
+    std::printf("Pendulum Run Executor Test %s\n", pass ? "Passed" : "Failed");
+
+    // A sweep sets the actor-critic fields of each config, and its cells
+    // take the steps of serial runs
+    pass = true;
+    {
+        AgentInit swept = params;
+        bool thrown = false;
+        try
+        {
+            set_agent_param(swept, "trace_type", "Dutch");
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        if (!set_agent_param(swept, "critic_step_size", "0.5") || swept.critic_step_size != 0.5 ||
+            !set_agent_param(swept, "use_seed", "false") || swept.use_seed ||
+            set_agent_param(swept, "num_steps", "10") || !thrown)
+        {
+            pass = false;
+            std::printf("test failed!\nset_agent_param misread a field\n");
+        }
+
+        const std::string config_path = "pendulum_test_sweep.cfg";
+        const std::string results_path = "pendulum_test_sweep.txt";
+        std::remove(results_path.c_str());
+        std::ofstream(config_path) << "mode = list\n"
+                                   << "num_runs = 2\n"
+                                   << "results = " << results_path << "\n"
+                                   << "num_steps = 500\n"
+                                   << "actor_step_size = 0.0078125, 0.015625\n";
+
+        EnvironmentInit env_init = {0, true};
+        Sweep sweep(config_path, env_init, params, {"num_steps"});
+        sweep.run([]() { return std::make_shared<PendulumEnvironment>(); },
+                  []() { return std::make_shared<ActorCriticAgent>(); },
+                  [](RL& rl, const Sweep::Config& config, const unsigned int)
+        {
+            std::vector<double> rewards(std::stoul(Sweep::get_value(config, "num_steps", "1")));
+            rl.rl_start();
+            for (auto& reward : rewards)
+                reward = std::get<0>(rl.rl_step()).reward;
+            return rewards;
+        }, 2);
+
+        StaticRL<PendulumEnvironment, ActorCriticAgent> rl;
+        for (std::size_t config=0; config < sweep.get_num_configs(); ++config)
+            for (unsigned int run=0; run < 2; ++run)
+            {
+                AgentInit cell_params = params;
+                cell_params.actor_step_size = config == 0 ? 0.0078125 : 0.015625;
+                env_init.run = cell_params.run = run;
+                rl.rl_init(env_init, cell_params);
+                rl.rl_start();
+                std::vector<double> rewards(500);
+                for (auto& reward : rewards)
+                    reward = std::get<0>(rl.rl_step()).reward;
+                if (sweep.get_result(config, run) != rewards)
+                {
+                    pass = false;
+                    std::printf("test failed!\nconfig %zu run %u took other steps than a serial run\n", config, run);
+                }
+            }
+
+        std::remove(config_path.c_str());
+        std::remove(results_path.c_str());
+    }
+    std::printf("Pendulum Sweep Test %s\n", pass ? "Passed" : "Failed");
+
+    // The batch follows the scalar physics recorded in pendulum_step.txt,
+    // three runs of 15000 steps from rest, replayed one step at a time from
+    // the recorded states
+    pass = true;
+    {
+        const double pi = PendulumBatchEnv::pi;  // in double, unlike the tile coder's
+        for (int i=0; i <= 1000 && pass; ++i)
+        {
+            double x = -pi + i * 2*pi / 1000;
+            if (std::abs(sin_approx(x) - std::sin(x)) > 1e-14)
+            {
+                pass = false;
+                std::printf("test failed!\nsin(%f) = %.17f instead of %.17f\n", x, sin_approx(x), std::sin(x));
+            }
+        }
+
+        struct Row { double torque, angle, velocity, reward; };
+        std::vector<Row> rows;
+        std::ifstream file(PENDULUM_STEP_FILE);
+        std::string tag;
+        Row row;
+        double unwrapped_angle, shifted_angle;
+        while (file >> tag >> row.torque >> unwrapped_angle >> row.angle >> row.velocity
+                    >> shifted_angle >> row.reward)
+            rows.push_back(row);
+        if (rows.size() != 45000)
+        {
+            pass = false;
+            std::printf("test failed!\nread %zu steps from %s\n", rows.size(), PENDULUM_STEP_FILE);
+        }
+
+        // Each pendulum replays its own share of the recording; six of them
+        // exercise both the AVX2 block and the scalar tail
+        constexpr std::size_t num_pendulums = 6;
+        constexpr std::size_t run_length = 15000;
+        const std::size_t share = rows.size() / num_pendulums;
+        PendulumBatchEnv batch;
+        batch.env_init(num_pendulums);
+        batch.env_start();
+        std::vector<Action> actions(num_pendulums);
+        auto angle_error = [pi](double a, double b) {
+            double d = std::fmod(std::abs(a - b), 2*pi);
+            return std::min(d, 2*pi - d);
+        };
+        for (std::size_t step=0; step < share && pass; ++step)
+        {
+            for (std::size_t i=0; i < num_pendulums; ++i)
+            {
+                const std::size_t k = i * share + step;
+                if (k % run_length == 0)
+                    batch.set_state(i, {-pi, 0});
+                else
+                    batch.set_state(i, {rows[k - 1].angle, rows[k - 1].velocity});
+                actions[i] = static_cast<Action>(rows[k].torque + 1);
+            }
+            batch.env_step(actions.data());
+
+            for (std::size_t i=0; i < num_pendulums && pass; ++i)
+            {
+                const Row& expected = rows[i * share + step];
+                if (std::abs(batch.get_velocities()[i] - expected.velocity) > 1e-5 ||
+                    angle_error(batch.get_angles()[i], expected.angle) > 1e-5 ||
+                    std::abs(batch.get_rewards()[i] - expected.reward) > 1e-5)
+                {
+                    pass = false;
+                    std::printf("test failed!\nstep %zu: (%f, %f) reward %f instead of (%f, %f) reward %f\n",
+                            i * share + step, batch.get_angles()[i], batch.get_velocities()[i],
+                            batch.get_rewards()[i], expected.angle, expected.velocity, expected.reward);
+                }
+            }
+        }
+
+        // A pendulum spun past 2 pi rad/s is put back at rest and reported
+        batch.set_state(4, {0, 2*pi + 0.1});
+        batch.set_state(1, {0, -2*pi - 0.1});
+        std::fill(actions.begin(), actions.end(), 1);
+        batch.env_step(actions.data());
+        for (std::size_t i=0; i < num_pendulums; ++i)
+        {
+            const bool spun = i == 1 || i == 4;
+            if (batch.is_reset(i) != spun ||
+                (spun && (batch.get_angles()[i] != -pi || batch.get_velocities()[i] != 0)))
+            {
+                pass = false;
+                std::printf("test failed!\npendulum %zu was %sreset\n", i, spun ? "not " : "");
+            }
+        }
+    }
+    std::printf("Pendulum Batch Environment Test %s\n", pass ? "Passed" : "Failed");
+
+    // A result file holds its columns at 64 byte aligned offsets after the
+    // header, bit for bit, and the header names their dtypes and shapes
+    pass = true;
+    {
+        const std::string path = "pendulum_test_results.bin";
+        std::vector<double> returns(2 * 3 * 4), rewards(5);
+        for (std::size_t i=0; i < returns.size(); ++i)
+            returns[i] = -0.25 * i;
+        for (std::size_t i=0; i < rewards.size(); ++i)
+            rewards[i] = std::sqrt(i + 1.0);
+
+        ResultFile results;
+        results.set_config("num_runs", "3");
+        results.add_column("returns", {2, 3, 4}, returns.data());
+        results.add_column("exp_avg_rewards", {5}, rewards.data());
+        results.write(path);
+
+        std::ifstream file(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+
+        std::uint32_t header_size = 0;
+        if (bytes.size() >= 16)
+            std::memcpy(&header_size, bytes.data() + 12, 4);
+        const std::string header = bytes.substr(16, header_size);
+        const std::size_t data_start = 16 + header_size;
+        if (bytes.compare(0, 8, "RLRESULT") != 0 || data_start % 64 != 0 ||
+            header.find("\"name\": \"returns\", \"dtype\": \"<f8\", \"shape\": [2, 3, 4], \"offset\": 0}") == std::string::npos ||
+            header.find("\"name\": \"exp_avg_rewards\", \"dtype\": \"<f8\", \"shape\": [5], \"offset\": 192}") == std::string::npos)
+        {
+            pass = false;
+            std::printf("test failed!\nunexpected header: %s\n", header.c_str());
+        }
+        else if (bytes.size() != data_start + 256 ||
+                 std::memcmp(bytes.data() + data_start, returns.data(), returns.size() * sizeof(double)) != 0 ||
+                 std::memcmp(bytes.data() + data_start + 192, rewards.data(), rewards.size() * sizeof(double)) != 0)
+        {
+            pass = false;
+            std::printf("test failed!\ncolumns not stored at their offsets\n");
+        }
+        std::remove(path.c_str());
+    }
+    std::printf("Pendulum Result File Test %s\n", pass ? "Passed" : "Failed");
+
     std::random_device rd;
     std::mt19937 gen(rd());
 
@@ -8,70 +8,45 @@ import sys
 import matplotlib.pyplot as plt
 import numpy as np
 
-
-def open_file(filename):
-    try:
-        f = open(filename)
-    except IOError:
-        text = 'Couldn\'t open \"%s\" for reading\n' % filename
-        sys.stderr.write(text)
-        return None
-    return f
+# Local
+from result_file import read_results
 
 
 def main():
-    if len(sys.argv) != 3:
-        print('usage: python plot.py <file1> <file2>')
+    if len(sys.argv) != 2:
+        print('usage: python plot.py results.bin')
         exit(1)
 
     fig, ax = plt.subplots(nrows=2, ncols=1, figsize=(12, 14))
 
-    file1 = str(sys.argv[1])
-    data_len = create_plot1(file1, ax[0])
+    config, columns = read_results(str(sys.argv[1]))
+    labels = [config["config_%d" % i] for i in range(columns["returns"].shape[0])]
 
-    file2 = str(sys.argv[2])
-    create_plot2(file2, ax[1])
+    create_plot1(columns["returns"], labels, ax[0])
+    create_plot2(columns["exp_avg_rewards"], labels, ax[1])
 
-    plt.suptitle("Average Reward Softmax Actor-Critic ({} Runs)".format(data_len),fontsize=16, fontweight='bold', y=1.03)
+    plt.suptitle("Average Reward Softmax Actor-Critic ({} Runs)".format(config["num_runs"]),
+                 fontsize=16, fontweight='bold', y=1.03)
 
     plt.show()
 
 
-def create_plot1(filename, ax):
-    """Load the data from the file ``filename``, and generate the
-    corresponding plot.
+def create_plot1(data, labels, ax):
+    """Plot the mean over the runs of ``data``, one row of runs per config,
+    with its standard error.
     """
     plt_xticks = [0, 4999, 9999, 14999, 19999]
     plt_xlabels = [1, 5000, 10000, 15000, 20000]
     plt1_yticks = range(0, -6001, -2000)
 
-    actor_ss, critic_ss, avg_reward_ss = 0, 0, 0
-
-    f = open_file(filename)
-    if not f:
-        return
-
-    lines = f.readlines()
-    f.close()
-
-    data = []
-    for line in lines:
-        cols = line.split(' ')
-        val = float(cols[0])
-        data.append(val)
-
-    data = np.array(data)
-    data = np.reshape(data, (25, 20000))
-
-    data_mean = np.mean(data, axis=0)
-    data_std_err = np.std(data, axis=0) / np.sqrt(len(data))
+    for runs, label in zip(data, labels):
+        data_mean = np.mean(runs, axis=0)
+        data_std_err = np.std(runs, axis=0) / np.sqrt(len(runs))
 
-    plt_x_legend = range(len(data_mean))
+        plt_x_legend = range(len(data_mean))
 
-    ax.fill_between(plt_x_legend, data_mean - data_std_err, data_mean + data_std_err, alpha=0.2)
-    ax.plot(plt_x_legend, data_mean, linewidth=1.0,
-            label="actor_ss: {}/32, critic_ss: {}/32, avg reward step_size{}".
-            format(actor_ss, critic_ss, avg_reward_ss))
+        ax.fill_between(plt_x_legend, data_mean - data_std_err, data_mean + data_std_err, alpha=0.2)
+        ax.plot(plt_x_legend, data_mean, linewidth=1.0, label=label)
 
     # ax.legend()
     ax.set_xticks(plt_xticks)
@@ -85,44 +60,24 @@ def create_plot1(filename, ax):
     ax.set_xlim([0, 20000])
     ax.grid(True)
 
-    return len(data_mean)
 
-
-def create_plot2(filename, ax):
-    """Load the data from the file ``filename``, and generate the
-    corresponding plot.
+def create_plot2(data, labels, ax):
+    """Plot the mean over the runs of ``data``, one row of runs per config,
+    with its standard error.
     """
     x_range = 20000
     plt_xticks = [0, 4999, 9999, 14999, 19999]
     plt_xlabels = [1, 5000, 10000, 15000, 20000]
     plt2_yticks = range(-3, 1, 1)
 
-    actor_ss, critic_ss, avg_reward_ss = 0, 0, 0
-
-    f = open_file(filename)
-    if not f:
-        return
-
-    lines = f.readlines()
-    f.close()
-
-    data = []
-    for line in lines:
-        cols = line.split(' ')
-        val = float(cols[0])
-        data.append(val)
-
-    data = np.array(data)
-    data = np.reshape(data, (25, 20000))
-
-    data_mean = np.mean(data, axis=0)
-    data_std_err = np.std(data, axis=0) / np.sqrt(len(data))
+    for runs, label in zip(data, labels):
+        data_mean = np.mean(runs, axis=0)
+        data_std_err = np.std(runs, axis=0) / np.sqrt(len(runs))
 
-    plt_x_legend = range(1, len(data_mean) + 1)
+        plt_x_legend = range(1, len(data_mean) + 1)
 
-    ax.fill_between(plt_x_legend, data_mean - data_std_err, data_mean + data_std_err, alpha=0.2)
-    ax.plot(plt_x_legend, data_mean, linewidth=1.0,
-            label="actor: {}/32, critic: {}/32, avg reward: {}".format(actor_ss, critic_ss, avg_reward_ss))
+        ax.fill_between(plt_x_legend, data_mean - data_std_err, data_mean + data_std_err, alpha=0.2)
+        ax.plot(plt_x_legend, data_mean, linewidth=1.0, label=label)
 
     # ax.legend()
     ax.set_xticks(plt_xticks)
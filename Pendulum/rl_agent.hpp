@@ -1,15 +1,299 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 #include "boost/multi_array.hpp"
+#include "bfloat16.hpp"
+#include "eligibility_traces.hpp"
 #include "rl_types.hpp"
+#include "rng.hpp"
 #include "tc.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace rl {
 namespace agent {
 
+// How an agent stores its weights, one per (action, tile)
+//   ActionMajor - the weights of each action are contiguous
+//   TileMajor   - the weights of each tile for all actions are contiguous,
+//                 padded to whole SIMD registers, so the action values of a
+//                 tile are one load away
+enum class WeightLayout { ActionMajor, TileMajor };
+
+// Linear function approximation weights indexed as weights[action][tile]
+// in either layout. Rows are strided views, so code that touches a single
+// action works the same way whichever the layout.
+// Weights are stored as S and action values and updates computed in F, e.g.
+// float or bfloat16 storage to shrink the table with float or double math.
+template <class S, class F = S>
+class ActionWeights
+{
+public:
+    // Actions per 32 byte register
+    static constexpr std::size_t simd_width = 32 / sizeof(S);
+
+    template <class T>
+    class Row
+    {
+    public:
+        Row(T* _ptr, const std::size_t _stride) : ptr(_ptr), stride(_stride) { }
+        T& operator[](const std::size_t tile) const { return ptr[tile * stride]; }
+
+    private:
+        T* ptr;
+        std::size_t stride;
+    };
+
+    // All weights are zero after a resize
+    void resize(const std::size_t _num_actions, const std::size_t num_tiles,
+                const WeightLayout _layout = WeightLayout::ActionMajor)
+    {
+        num_actions = _num_actions;
+        layout = _layout;
+        if (layout == WeightLayout::TileMajor)
+        {
+            padded_actions = (num_actions + simd_width - 1) / simd_width * simd_width;
+            action_stride = 1;
+            tile_stride = padded_actions;
+        }
+        else
+        {
+            padded_actions = num_actions;
+            action_stride = num_tiles;
+            tile_stride = 1;
+        }
+        weights.assign(padded_actions * num_tiles, 0);
+    }
+
+    Row<S> operator[](const std::size_t action)
+    {
+        return Row<S>(weights.data() + action * action_stride, tile_stride);
+    }
+    Row<const S> operator[](const std::size_t action) const
+    {
+        return Row<const S>(weights.data() + action * action_stride, tile_stride);
+    }
+
+    WeightLayout get_layout() const { return layout; }
+    // Number of action values add_action_values writes, at least num_actions
+    std::size_t get_padded_actions() const { return padded_actions; }
+
+    /* Adds the weights of the active tiles to the value of every action,
+     * q[a] += sum_j weights[a][tiles[j]], summing the tiles in order either way.
+     * q must hold get_padded_actions() values.
+     */
+    void add_action_values(const tc::TileSpan tiles, F* q) const
+    {
+        if (layout == WeightLayout::TileMajor)
+        {
+            for (std::size_t j = 0; j < tiles.size(); ++j)
+            {
+                const S* w = weights.data() + tiles[j] * tile_stride;
+                for (std::size_t a = 0; a < padded_actions; ++a)
+                    q[a] += w[a];
+            }
+        }
+        else
+        {
+            for (std::size_t a = 0; a < num_actions; ++a)
+            {
+                const S* w = weights.data() + a * action_stride;
+                for (std::size_t j = 0; j < tiles.size(); ++j)
+                    q[a] += w[tiles[j]];
+            }
+        }
+    }
+
+    /* weights[a][tile] += deltas[a] for every action; deltas must hold
+     * get_padded_actions() values */
+    void add(const std::uint32_t tile, const F* deltas)
+    {
+        if (layout == WeightLayout::TileMajor)
+        {
+            S* w = weights.data() + tile * tile_stride;
+            for (std::size_t a = 0; a < padded_actions; ++a)
+                w[a] = static_cast<S>(w[a] + deltas[a]);
+        }
+        else
+        {
+            S* w = weights.data() + tile;
+            for (std::size_t a = 0; a < num_actions; ++a)
+                w[a * action_stride] = static_cast<S>(w[a * action_stride] + deltas[a]);
+        }
+    }
+
+    /* weights[a][tile] += scale * values[a] for every action; values must
+     * hold get_padded_actions() values */
+    void add(const std::uint32_t tile, const F* values, const F scale)
+    {
+        if (layout == WeightLayout::TileMajor)
+        {
+            S* w = weights.data() + tile * tile_stride;
+            for (std::size_t a = 0; a < padded_actions; ++a)
+                w[a] = static_cast<S>(w[a] + scale * values[a]);
+        }
+        else
+        {
+            S* w = weights.data() + tile;
+            for (std::size_t a = 0; a < num_actions; ++a)
+                w[a * action_stride] = static_cast<S>(w[a * action_stride] + scale * values[a]);
+        }
+    }
+
+    /* weights[a][tiles[j]] += deltas[a] for every active tile and action */
+    void add(const tc::TileSpan tiles, const F* deltas)
+    {
+        if (layout == WeightLayout::TileMajor)
+        {
+            for (std::size_t j = 0; j < tiles.size(); ++j)
+            {
+                S* w = weights.data() + tiles[j] * tile_stride;
+                for (std::size_t a = 0; a < num_actions; ++a)
+                    w[a] = static_cast<S>(w[a] + deltas[a]);
+            }
+        }
+        else
+        {
+            for (std::size_t a = 0; a < num_actions; ++a)
+            {
+                S* w = weights.data() + a * action_stride;
+                for (std::size_t j = 0; j < tiles.size(); ++j)
+                    w[tiles[j]] = static_cast<S>(w[tiles[j]] + deltas[a]);
+            }
+        }
+    }
+
+private:
+    std::vector<S> weights;
+    std::size_t num_actions{0};
+    std::size_t padded_actions{0};
+    std::size_t action_stride{0};
+    std::size_t tile_stride{1};
+    WeightLayout layout{WeightLayout::ActionMajor};
+};
+
+// Storage and arithmetic types of the agents' weights, picked with
+// WEIGHT_PRECISION in CMake: double (default), float, mixed (float storage,
+// double arithmetic) or bfloat16 (bfloat16 storage, float arithmetic)
+#if defined(WEIGHTS_FLOAT)
+using WeightStorage = float;
+using WeightMath = float;
+#elif defined(WEIGHTS_MIXED)
+using WeightStorage = float;
+using WeightMath = double;
+#elif defined(WEIGHTS_BFLOAT16)
+using WeightStorage = bfloat16;
+using WeightMath = float;
+#else
+using WeightStorage = double;
+using WeightMath = double;
+#endif
+
+// Greedy selection over at most 32 action values without touching the heap.
+// ties_mask() returns the largest of q[0, n) and sets bit i of mask for every
+// q[i] equal to it. q must be readable for 32 values, whatever n. NaN values
+// are skipped, so they never win or tie; when every value is NaN the mask is
+// empty and -inf is returned. The AVX2 versions follow the same rule.
+template <class F>
+inline F ties_mask(const F* q, unsigned int n, uint32_t& mask)
+{
+    F top = -HUGE_VAL;
+    for (unsigned int i = 0; i < n; ++i)
+        if (q[i] > top)
+            top = q[i];
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; ++i)
+        if (q[i] == top)
+            mask |= uint32_t{1} << i;
+    return top;
+}
+
+#ifdef __AVX2__
+/* Lanes at or past n, and NaN lanes, are filled with -inf so they never win
+ * or tie */
+inline float ties_mask(const float* q, unsigned int n, uint32_t& mask)
+{
+    const __m256 lowest = _mm256_set1_ps(-HUGE_VALF);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 top = lowest;
+    for (unsigned int i = 0; i < n; i += 8)
+    {
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), lanes);
+        __m256 v = _mm256_loadu_ps(q + i);
+        __m256 keep = _mm256_and_ps(_mm256_castsi256_ps(valid), _mm256_cmp_ps(v, v, _CMP_ORD_Q));
+        v = _mm256_blendv_ps(lowest, v, keep);
+        top = _mm256_max_ps(top, v);
+    }
+    top = _mm256_max_ps(top, _mm256_permute2f128_ps(top, top, 1));
+    top = _mm256_max_ps(top, _mm256_shuffle_ps(top, top, _MM_SHUFFLE(1, 0, 3, 2)));
+    top = _mm256_max_ps(top, _mm256_shuffle_ps(top, top, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; i += 8)
+    {
+        __m256 eq = _mm256_cmp_ps(_mm256_loadu_ps(q + i), top, _CMP_EQ_OQ);
+        mask |= static_cast<uint32_t>(_mm256_movemask_ps(eq)) << i;
+    }
+    if (n < 32)
+        mask &= (uint32_t{1} << n) - 1;
+    return _mm256_cvtss_f32(top);
+}
+
+inline double ties_mask(const double* q, unsigned int n, uint32_t& mask)
+{
+    const __m256d lowest = _mm256_set1_pd(-HUGE_VAL);
+    const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+
+    __m256d top = lowest;
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+        __m256i valid = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i), lanes);
+        __m256d v = _mm256_loadu_pd(q + i);
+        __m256d keep = _mm256_and_pd(_mm256_castsi256_pd(valid), _mm256_cmp_pd(v, v, _CMP_ORD_Q));
+        v = _mm256_blendv_pd(lowest, v, keep);
+        top = _mm256_max_pd(top, v);
+    }
+    top = _mm256_max_pd(top, _mm256_permute2f128_pd(top, top, 1));
+    top = _mm256_max_pd(top, _mm256_shuffle_pd(top, top, 0x5));
+
+    mask = 0;
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+        __m256d eq = _mm256_cmp_pd(_mm256_loadu_pd(q + i), top, _CMP_EQ_OQ);
+        mask |= static_cast<uint32_t>(_mm256_movemask_pd(eq)) << i;
+    }
+    if (n < 32)
+        mask &= (uint32_t{1} << n) - 1;
+    return _mm256_cvtsd_f64(top);
+}
+#endif
+
+/* Position of the k-th lowest set bit of mask, counting from 0; mask must
+ * have more than k bits set */
+inline unsigned int select_bit(uint32_t mask, unsigned int k)
+{
+#ifdef __BMI2__
+    return __builtin_ctz(_pdep_u32(uint32_t{1} << k, mask));
+#else
+    for (; k > 0; --k)
+        mask &= mask - 1;
+    return __builtin_ctz(mask);
+#endif
+}
+
 struct AgentInit {
     unsigned int num_actions{0};
     unsigned int num_states{0};
@@ -18,12 +302,23 @@ struct AgentInit {
     double discount{1.0};  // the discount factor
     unsigned int seed{0};
     bool use_seed{false};
+    unsigned int run{0};  // each run of an experiment draws its own stream
 
     // TODO: subclass these
     // Additional parameters for tile coding
     unsigned int num_tilings{0};
     unsigned int num_tiles{0};
     unsigned int index_hash_table_size{0};
+    tc::OverflowPolicy overflow_policy{tc::OverflowPolicy::Throw};
+    tc::TileIndexing tile_indexing{tc::TileIndexing::Hashed};
+    // Share one tile to index mapping between agents, e.g. across threads,
+    // or warm start from a table saved by an earlier run
+    std::shared_ptr<tc::SharedIndexTable<3>> shared_index_table{};
+    WeightLayout weight_layout{WeightLayout::ActionMajor};
+    // Eligibility traces; lambda = 0 gives the one-step methods
+    double lambda{0};
+    TraceType trace_type{TraceType::Accumulating};
+    double trace_threshold{1e-4};  // smaller traces are dropped
 
     // Additional parameters for actor/critic agent
     double actor_step_size{0};
@@ -31,6 +326,107 @@ struct AgentInit {
     double avg_reward_step_size{0};
 };
 
+/* Sets the AgentInit field called name from its text, e.g. a value of a
+ * sweep config. Returns false, leaving params as they were, if there is no
+ * such field; throws std::invalid_argument for a value it cannot read.
+ */
+inline bool set_agent_param(AgentInit& params, const std::string& name, const std::string& value)
+{
+    auto choice = [&](const std::initializer_list<const char*> names) {
+        unsigned int i = 0;
+        for (const char* choice_name : names)
+        {
+            if (value == choice_name)
+                return i;
+            ++i;
+        }
+        throw std::invalid_argument(name + " cannot be " + value);
+    };
+
+    if (name == "num_actions")
+        params.num_actions = std::stoul(value);
+    else if (name == "num_states")
+        params.num_states = std::stoul(value);
+    else if (name == "epsilon")
+        params.epsilon = std::stod(value);
+    else if (name == "step_size")
+        params.step_size = std::stod(value);
+    else if (name == "discount")
+        params.discount = std::stod(value);
+    else if (name == "seed")
+        params.seed = std::stoul(value);
+    else if (name == "use_seed")
+        params.use_seed = choice({"false", "true"});
+    else if (name == "num_tilings")
+        params.num_tilings = std::stoul(value);
+    else if (name == "num_tiles")
+        params.num_tiles = std::stoul(value);
+    else if (name == "index_hash_table_size")
+        params.index_hash_table_size = std::stoul(value);
+    else if (name == "overflow_policy")
+        params.overflow_policy = static_cast<tc::OverflowPolicy>(choice({"Throw", "Fold", "HashOnly"}));
+    else if (name == "tile_indexing")
+        params.tile_indexing = static_cast<tc::TileIndexing>(choice({"Hashed", "Dense"}));
+    else if (name == "weight_layout")
+        params.weight_layout = static_cast<WeightLayout>(choice({"ActionMajor", "TileMajor"}));
+    else if (name == "lambda")
+        params.lambda = std::stod(value);
+    else if (name == "trace_type")
+        params.trace_type = static_cast<TraceType>(choice({"Accumulating", "Replacing"}));
+    else if (name == "trace_threshold")
+        params.trace_threshold = std::stod(value);
+    else if (name == "actor_step_size")
+        params.actor_step_size = std::stod(value);
+    else if (name == "critic_step_size")
+        params.critic_step_size = std::stod(value);
+    else if (name == "avg_reward_step_size")
+        params.avg_reward_step_size = std::stod(value);
+    else
+        return false;
+    return true;
+}
+
+/* The AgentInit fields that set_agent_param sets, as name=value pairs
+ * separated by spaces, spelled as it reads them and reals with the digits to
+ * read them back exactly. The run and any shared index table are left out.
+ */
+inline std::string format_agent_params(const AgentInit& params)
+{
+    std::string text;
+    auto add = [&](const char* name, const std::string& value) {
+        text += (text.empty() ? "" : " ") + std::string(name) + "=" + value;
+    };
+    auto real = [](const double value) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", value);
+        return std::string(number);
+    };
+    auto choice = [](const unsigned int i, const std::initializer_list<const char*> names) {
+        return std::string(names.begin()[i]);
+    };
+
+    add("num_actions", std::to_string(params.num_actions));
+    add("num_states", std::to_string(params.num_states));
+    add("epsilon", real(params.epsilon));
+    add("step_size", real(params.step_size));
+    add("discount", real(params.discount));
+    add("seed", std::to_string(params.seed));
+    add("use_seed", choice(params.use_seed, {"false", "true"}));
+    add("num_tilings", std::to_string(params.num_tilings));
+    add("num_tiles", std::to_string(params.num_tiles));
+    add("index_hash_table_size", std::to_string(params.index_hash_table_size));
+    add("overflow_policy", choice(static_cast<unsigned int>(params.overflow_policy), {"Throw", "Fold", "HashOnly"}));
+    add("tile_indexing", choice(static_cast<unsigned int>(params.tile_indexing), {"Hashed", "Dense"}));
+    add("weight_layout", choice(static_cast<unsigned int>(params.weight_layout), {"ActionMajor", "TileMajor"}));
+    add("lambda", real(params.lambda));
+    add("trace_type", choice(static_cast<unsigned int>(params.trace_type), {"Accumulating", "Replacing"}));
+    add("trace_threshold", real(params.trace_threshold));
+    add("actor_step_size", real(params.actor_step_size));
+    add("critic_step_size", real(params.critic_step_size));
+    add("avg_reward_step_size", real(params.avg_reward_step_size));
+    return text;
+}
+
 class Agent {
 public:
     Agent () = default;
@@ -43,6 +439,9 @@ public:
     virtual void agent_cleanup() = 0;
     virtual std::string agent_message(const std::string& message) = 0;
 
+    // Upper bound on num_actions; action values live in fixed size scratch
+    static constexpr unsigned int max_actions = 32;
+
 protected:
     unsigned int num_actions{0};
     unsigned int num_states{0};
@@ -50,71 +449,54 @@ protected:
     double step_size{0.1}; // alpha
     double discount{1.0};  // the discount factor (aka gamma)
     unsigned int seed{0};
-    std::mt19937 gen;  // Standard mersenne_twister_engine
-    std::uniform_real_distribution<> rand_real;
-    std::uniform_int_distribution<> rand_int;
+    rng::Engine gen;  // picked with RNG_ENGINE, std::mt19937 by default
 
     State prev_state;
     Action prev_action{0};
 
     using Float2D = boost::multi_array<double, 2>;
     Float2D q_values;
-    Float2D weights;
+
+    /* picks one of the actions set in ties uniformly, drawing from gen just
+     * as indexing a list of the tied actions would. No ties means every
+     * action value was NaN, e.g. once the weights diverged; any action is
+     * then as good as another, so all of them tie */
+    Action break_ties(uint32_t ties)
+    {
+        if (ties == 0)
+            ties = num_actions < 32 ? (uint32_t{1} << num_actions) - 1 : ~uint32_t{0};
+        return select_bit(ties, rng::uniform_int(gen, __builtin_popcount(ties)));
+    }
 
     /* argmax but with random tie-breaking */
     std::pair<Action, double> argmax(Float2D::array_view<1>::type q_view)
     {
-        double top = -HUGE_VALF;
-        std::vector<unsigned int> ties;
-
-        using index = Float2D::index;
-        for(index i = 0; i < num_actions; ++i)
-        {
-            if (q_view[i] > top)
-            {
-                top = q_view[i];
-                ties.clear();
-            }
-            if (q_view[i] == top)
-                ties.push_back(i);
-        }
+        std::array<double, max_actions> q{};
+        for (unsigned int i = 0; i < num_actions; ++i)
+            q[i] = q_view[i];
 
-        std::uniform_int_distribution<> sample(0, ties.size()-1);
-        Action winning_idx = ties[sample(gen)];
-        double winning_val = q_view[winning_idx];
-
-        return std::make_pair(winning_idx, winning_val);
+        uint32_t ties;
+        double top = ties_mask(q.data(), num_actions, ties);
+        return std::make_pair(break_ties(ties), top);
     }
 
     /* selects an action using epsilon greedy with random tie-breaking */
-    std::pair<Action, double> select_action(const std::vector<uint32_t>& tiles)
+    template <class S, class F>
+    std::pair<Action, F> select_action(const ActionWeights<S, F>& weights, const tc::TileSpan tiles)
     {
-        std::vector<double> q_values(num_actions, 0);
-        for(Action i = 0; i < num_actions; ++i)
-        {
-            for (std::size_t j=0; j < tiles.size(); ++j)
-                q_values[i] += weights[i][tiles[j]];
-        }
-
-        double top = -HUGE_VALF;
-        std::vector<unsigned int> ties;
-
-        for(unsigned i = 0; i < num_actions; ++i)
-        {
-            if (q_values[i] > top)
-            {
-                top = q_values[i];
-                ties.clear();
-            }
-            if (q_values[i] == top)
-                ties.push_back(i);
-        }
-
-        std::uniform_int_distribution<> sample(0, ties.size()-1);
-        Action winning_idx = ties[sample(gen)];
-        double winning_val = q_values[winning_idx];
+        std::array<F, max_actions> q_values{};
+        weights.add_action_values(tiles, q_values.data());
+        return select_action(q_values.data());
+    }
 
-        return std::make_pair(winning_idx, winning_val);
+    /* the same, from action values already summed; q_values must hold
+     * max_actions values */
+    template <class F>
+    std::pair<Action, F> select_action(const F* q_values)
+    {
+        uint32_t ties;
+        F top = ties_mask(q_values, num_actions, ties);
+        return std::make_pair(break_ties(ties), top);
     }
 
 };
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+
+/* Random number engines for agents and environments.
+ *
+ * Every engine is keyed by (seed, run, stream): runs of an experiment and the
+ * agent and environment within a run each get a stream of their own, so
+ * results do not depend on which runs share a thread or in what order they
+ * execute. The engine is picked at compile time with RNG_ENGINE in CMake:
+ *
+ *   mt19937  - std::mt19937 (default); (seed, 0, 0) seeds it exactly as
+ *              std::mt19937(seed) does, so existing results reproduce
+ *   xoshiro  - xoshiro256++, 32 bytes of state
+ *   philox   - Philox4x32-10, counter based: the key and counter are the
+ *              whole state and reseeding costs nothing
+ *
+ * The helpers below draw through the std distributions for std engines,
+ * keeping their streams bit for bit, and straight from the bits otherwise.
+ */
+namespace rng
+{
+
+// The stream of each consumer within a run
+constexpr uint64_t agent_stream = 0;
+constexpr uint64_t env_stream = 1;
+
+/* MurmurHash3 finalizer, used to spread keys over the engine state */
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t splitmix64(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* xoshiro256++ by Blackman and Vigna. Keys are hashed into the state; with a
+ * period of 2^256 - 1 distinct keys do not overlap in practice.
+ */
+class Xoshiro256
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed_value = 0, uint64_t run = 0, uint64_t stream = 0)
+    {
+        seed(seed_value, run, stream);
+    }
+
+    void seed(uint64_t seed_value, uint64_t run = 0, uint64_t stream = 0)
+    {
+        uint64_t x = mix64(seed_value ^ mix64(run ^ mix64(stream + 0x9e3779b97f4a7c15ULL)));
+        for (auto& word : s)
+            word = splitmix64(x);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+private:
+    static uint64_t rotl(const uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s[4];
+};
+
+/* Philox4x32-10 by Salmon et al. The seed is the key and (run, stream) fill
+ * the upper half of the counter, so streams never overlap; the lower half
+ * counts blocks of four 32 bit outputs, returned as two 64 bit values.
+ */
+class Philox4x32
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Philox4x32(uint64_t seed_value = 0, uint64_t run = 0, uint64_t stream = 0)
+    {
+        seed(seed_value, run, stream);
+    }
+
+    void seed(uint64_t seed_value, uint64_t run = 0, uint64_t stream = 0)
+    {
+        key[0] = static_cast<uint32_t>(seed_value);
+        key[1] = static_cast<uint32_t>(seed_value >> 32);
+        counter[0] = 0;
+        counter[1] = 0;
+        counter[2] = static_cast<uint32_t>(run);
+        counter[3] = static_cast<uint32_t>(stream);
+        next = 2;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        if (next == 2)
+        {
+            generate_block();
+            next = 0;
+        }
+        return block[next++];
+    }
+
+private:
+    void generate_block()
+    {
+        uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+        uint32_t k[2] = { key[0], key[1] };
+        for (int round = 0; round < 10; ++round)
+        {
+            const uint64_t p0 = uint64_t{0xD2511F53} * c[0];
+            const uint64_t p1 = uint64_t{0xCD9E8D57} * c[2];
+            const uint32_t hi0 = static_cast<uint32_t>(p0 >> 32), lo0 = static_cast<uint32_t>(p0);
+            const uint32_t hi1 = static_cast<uint32_t>(p1 >> 32), lo1 = static_cast<uint32_t>(p1);
+            c[0] = hi1 ^ c[1] ^ k[0];
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k[1];
+            c[3] = lo0;
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+        block[0] = (uint64_t{c[1]} << 32) | c[0];
+        block[1] = (uint64_t{c[3]} << 32) | c[2];
+
+        if (++counter[0] == 0)
+            ++counter[1];
+    }
+
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint64_t block[2];
+    unsigned int next;
+};
+
+#if defined(RNG_XOSHIRO)
+using Engine = Xoshiro256;
+#elif defined(RNG_PHILOX)
+using Engine = Philox4x32;
+#else
+using Engine = std::mt19937;
+#endif
+
+// Engines whose raw 64 bit output the helpers use directly
+template <class E> struct is_native : std::false_type {};
+template <> struct is_native<Xoshiro256> : std::true_type {};
+template <> struct is_native<Philox4x32> : std::true_type {};
+
+/* The engine for stream of run, with the given seed */
+template <class E = Engine>
+E make_engine(uint64_t seed, uint64_t run = 0, uint64_t stream = 0)
+{
+    if constexpr (is_native<E>::value)
+        return E(seed, run, stream);
+    else if (run == 0 && stream == 0)
+        return E(static_cast<typename E::result_type>(seed));
+    else
+    {
+        std::seed_seq seq{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                           static_cast<uint32_t>(run), static_cast<uint32_t>(run >> 32),
+                           static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32) };
+        return E(seq);
+    }
+}
+
+/* Uniform double in [0, 1) */
+template <class E>
+inline double uniform(E& gen)
+{
+    if constexpr (is_native<E>::value)
+        return (gen() >> 11) * 0x1.0p-53;
+    else
+        return std::uniform_real_distribution<>(0, 1)(gen);
+}
+
+/* Uniform double in [a, b) */
+template <class E>
+inline double uniform(E& gen, const double a, const double b)
+{
+    if constexpr (is_native<E>::value)
+        return a + (b - a) * uniform(gen);
+    else
+        return std::uniform_real_distribution<>(a, b)(gen);
+}
+
+/* Uniform float in [0, 1) */
+template <class E>
+inline float uniform_float(E& gen)
+{
+    if constexpr (is_native<E>::value)
+        return (gen() >> 40) * 0x1.0p-24f;
+    else
+        return std::uniform_real_distribution<float>(0, 1)(gen);
+}
+
+/* Uniform integer in [0, n), n > 0. Lemire's multiply and shift, which
+ * divides only when a draw lands in the biased range.
+ */
+template <class E>
+inline unsigned int uniform_int(E& gen, const unsigned int n)
+{
+    if constexpr (is_native<E>::value)
+    {
+        uint64_t m = (gen() >> 32) * n;
+        if (static_cast<uint32_t>(m) < n)
+        {
+            const uint32_t threshold = (0u - n) % n;
+            while (static_cast<uint32_t>(m) < threshold)
+                m = (gen() >> 32) * n;
+        }
+        return static_cast<unsigned int>(m >> 32);
+    }
+    else
+        return std::uniform_int_distribution<>(0, n - 1)(gen);
+}
+
+/* true with probability p */
+template <class E>
+inline bool bernoulli(E& gen, const double p)
+{
+    return uniform(gen) < p;
+}
+
+/* Index drawn from [0, n) with probability weights[i] / sum(weights), for
+ * non-negative weights and one uniform draw. The running sums are formed as
+ * std::piecewise_constant_distribution forms them, so std engines pick the
+ * same index it would.
+ */
+template <class E, class F>
+inline unsigned int categorical(E& gen, const F* weights, const unsigned int n)
+{
+    F total = 0;
+    for (unsigned int i = 0; i < n; ++i)
+        total += weights[i];
+
+    const double u = uniform(gen);
+    F cumulative = 0;
+    for (unsigned int i = 0; i + 1 < n; ++i)
+    {
+        cumulative += weights[i] / total;
+        if (u <= cumulative)
+            return i;
+    }
+    return n - 1;
+}
+
+/* out[i] = uniform in [a, b) for i in [0, n) */
+template <class E, class F>
+inline void fill_uniform(E& gen, F* out, const std::size_t n, const F a = 0, const F b = 1)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if constexpr (std::is_same<F, float>::value)
+            out[i] = a + (b - a) * uniform_float(gen);
+        else
+            out[i] = static_cast<F>(uniform(gen, a, b));
+    }
+}
+
+} /* namespace rng */
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sweep.hpp"
+
+namespace rl {
+
+void run_work_stealing(const std::size_t num_tasks, unsigned int num_threads,
+                       const std::function<void(const std::size_t task)>& task)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = static_cast<unsigned int>(std::min<std::size_t>(num_threads, num_tasks));
+    if (num_threads == 0)
+        return;
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+    std::vector<TaskQueue> queues(num_threads);
+    for (unsigned int t = 0; t < num_threads; ++t)
+        for (std::size_t i = t * num_tasks / num_threads; i < (t + 1) * num_tasks / num_threads; ++i)
+            queues[t].tasks.push_back(i);
+
+    // No tasks are added once the threads start, so a thread that finds
+    // every queue empty is done
+    auto next_task = [&](const unsigned int t, std::size_t& next) {
+        {
+            std::lock_guard<std::mutex> lock(queues[t].mutex);
+            if (!queues[t].tasks.empty())
+            {
+                next = queues[t].tasks.front();
+                queues[t].tasks.pop_front();
+                return true;
+            }
+        }
+        for (unsigned int i = 1; i < num_threads; ++i)
+        {
+            TaskQueue& victim = queues[(t + i) % num_threads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                next = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::exception_ptr> errors(num_tasks);
+    auto worker = [&](const unsigned int t) {
+        std::size_t next;
+        while (next_task(t, next))
+        {
+            try
+            {
+                task(next);
+            }
+            catch (...)
+            {
+                errors[next] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < num_threads; ++t)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+namespace {
+
+std::string trim(const std::string& s)
+{
+    const auto first = s.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+}
+
+/* One cell as a line of a results file or shard: its run, its key and its
+ * values, separated by tabs
+ */
+std::string format_cell(const unsigned int run, const std::string& key, const std::vector<double>& values)
+{
+    std::string line = std::to_string(run) + "\t" + key + "\t" + std::to_string(values.size()) + "\t";
+    char number[32];
+    for (const double value : values)
+    {
+        std::snprintf(number, sizeof(number), "%.17g ", value);
+        line += number;
+    }
+    return line + "\n";
+}
+
+bool parse_cell(const std::string& line, unsigned int& run, std::string& key, std::vector<double>& values)
+{
+    std::istringstream fields(line);
+    std::string run_field, count, numbers;
+    if (!std::getline(fields, run_field, '\t') || !std::getline(fields, key, '\t') ||
+        !std::getline(fields, count, '\t') || !std::getline(fields, numbers))
+        return false;
+
+    run = std::strtoul(run_field.c_str(), nullptr, 10);
+    values.resize(std::strtoul(count.c_str(), nullptr, 10));
+    const char* next = numbers.c_str();
+    for (auto& value : values)
+    {
+        char* end;
+        value = std::strtod(next, &end);
+        next = end;
+    }
+    return true;
+}
+
+/* Creates the file at path, holding this host and process, unless it exists
+ * already. O_EXCL makes this atomic, also on NFS from version 3 on, so of
+ * the workers trying to claim a cell exactly one succeeds.
+ */
+bool claim(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd < 0)
+    {
+        if (errno == EEXIST)
+            return false;
+        throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+    }
+    char host[256] = "";
+    ::gethostname(host, sizeof(host) - 1);
+    const std::string owner = std::string(host) + " " + std::to_string(::getpid()) + "\n";
+    const bool written = ::write(fd, owner.data(), owner.size()) == static_cast<ssize_t>(owner.size());
+    ::close(fd);
+    if (!written)
+        throw std::runtime_error("cannot write " + path);
+    return true;
+}
+
+bool file_exists(const std::string& path)
+{
+    struct stat status;
+    return ::stat(path.c_str(), &status) == 0;
+}
+
+} // namespace
+
+Sweep::Sweep(const std::string& config_path, const EnvironmentInit& env_params, const AgentInit& agent_params,
+             const std::vector<std::string>& settings, const AgentDefaults& agent_defaults)
+    : env_params(env_params)
+{
+    read_config(config_path, settings);
+    for (const auto& config : configs)
+    {
+        // Names that are no AgentInit field are settings for run_cell,
+        // checked by read_config
+        AgentInit params = agent_params;
+        for (const auto& param : config)
+            set_agent_param(params, param.first, param.second);
+        if (agent_defaults)
+            agent_defaults(params, config);
+        config_agent_params.push_back(params);
+        keys.push_back(key(config, params));
+    }
+    read_results();
+}
+
+void Sweep::read_config(const std::string& config_path, const std::vector<std::string>& settings)
+{
+    std::ifstream file(config_path);
+    if (!file)
+        throw std::runtime_error("cannot open sweep config " + config_path);
+
+    std::string mode = "grid";
+    results_path = config_path + ".results";
+    std::vector<std::pair<std::string, std::vector<std::string>>> params;
+
+    std::string line;
+    for (unsigned int line_number = 1; std::getline(file, line); ++line_number)
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        const auto equals = line.find('=');
+        const std::string name = trim(line.substr(0, equals));
+        std::vector<std::string> values;
+        if (equals != std::string::npos)
+        {
+            std::istringstream list(line.substr(equals + 1));
+            for (std::string value; std::getline(list, value, ',');)
+                values.push_back(trim(value));
+        }
+        if (name.empty() || values.empty() ||
+            std::any_of(values.begin(), values.end(), [](const std::string& v) {
+                return v.empty() || v.find_first_of(" \t") != std::string::npos; }))
+            throw std::runtime_error(config_path + ":" + std::to_string(line_number) +
+                                     ": expected name = value, value, ...");
+
+        if (name == "mode")
+            mode = values[0];
+        else if (name == "num_runs")
+            num_runs = std::stoul(values[0]);
+        else if (name == "results")
+            results_path = values[0];
+        else if (std::find(settings.begin(), settings.end(), name) != settings.end())
+            params.emplace_back(name, values);
+        else
+        {
+            AgentInit probe;
+            for (const auto& value : values)
+            {
+                bool is_field;
+                try
+                {
+                    is_field = set_agent_param(probe, name, value);
+                }
+                catch (const std::logic_error& error)
+                {
+                    throw std::runtime_error(config_path + ":" + std::to_string(line_number) +
+                                             ": " + name + " cannot be " + value);
+                }
+                if (!is_field)
+                    throw std::runtime_error(config_path + ":" + std::to_string(line_number) + ": " + name +
+                                             " is neither an AgentInit field nor a setting of the driver");
+            }
+            params.emplace_back(name, values);
+        }
+    }
+
+    configs.clear();
+    if (mode == "grid")
+    {
+        // The first parameter varies slowest
+        std::size_t num_configs = 1;
+        for (const auto& param : params)
+            num_configs *= param.second.size();
+        for (std::size_t i = 0; i < num_configs; ++i)
+        {
+            Config config;
+            std::size_t rest = i;
+            for (auto param = params.rbegin(); param != params.rend(); ++param)
+            {
+                config.emplace_back(param->first, param->second[rest % param->second.size()]);
+                rest /= param->second.size();
+            }
+            std::reverse(config.begin(), config.end());
+            configs.push_back(config);
+        }
+    }
+    else if (mode == "list")
+    {
+        std::size_t num_configs = 1;
+        for (const auto& param : params)
+            num_configs = std::max(num_configs, param.second.size());
+        for (const auto& param : params)
+            if (param.second.size() != 1 && param.second.size() != num_configs)
+                throw std::runtime_error(config_path + ": " + param.first + " has " +
+                        std::to_string(param.second.size()) + " values, not 1 or " + std::to_string(num_configs));
+        for (std::size_t i = 0; i < num_configs; ++i)
+        {
+            Config config;
+            for (const auto& param : params)
+                config.emplace_back(param.first, param.second[param.second.size() == 1 ? 0 : i]);
+            configs.push_back(config);
+        }
+    }
+    else
+        throw std::runtime_error(config_path + ": mode is grid or list, not " + mode);
+}
+
+/* A line cut short when a sweep was stopped has no newline and is dropped */
+void Sweep::read_results()
+{
+    std::ifstream file(results_path);
+    std::string line, key;
+    unsigned int run;
+    std::vector<double> values;
+    while (std::getline(file, line) && !file.eof())
+        if (parse_cell(line, run, key, values))
+            results[{key, run}] = values;
+}
+
+/* The settings of config, then every field of its AgentInit and the seed of
+ * the environment
+ */
+std::string Sweep::key(const Config& config, const AgentInit& params) const
+{
+    std::string key;
+    AgentInit scratch;
+    for (const auto& param : config)
+        if (!set_agent_param(scratch, param.first, param.second))
+            key += param.first + "=" + param.second + " ";
+    return key + format_agent_params(params) + " env_seed=" + std::to_string(env_params.seed) +
+           " env_use_seed=" + (env_params.use_seed ? "true" : "false");
+}
+
+std::string Sweep::get_value(const Config& config, const std::string& name, const std::string& default_value)
+{
+    for (const auto& param : config)
+        if (param.first == name)
+            return param.second;
+    return default_value;
+}
+
+std::vector<double> Sweep::run_one(const std::size_t config, const unsigned int run,
+                                   const RunExecutor::EnvironmentFactory& make_env,
+                                   const RunExecutor::AgentFactory& make_agent,
+                                   const CellFunction& run_cell) const
+{
+    AgentInit run_agent_params = config_agent_params[config];
+    EnvironmentInit run_env_params = env_params;
+    run_env_params.run = run;
+    run_agent_params.run = run;
+
+    RL rl(make_env(), make_agent());
+    rl.rl_init(run_env_params, run_agent_params);
+    return run_cell(rl, configs[config], run);
+}
+
+void Sweep::store_result(const std::size_t config, const unsigned int run, std::vector<double> values)
+{
+    const std::string cell_key = keys[config];
+    const std::string line = format_cell(run, cell_key, values);
+
+    std::lock_guard<std::mutex> lock(results_mutex);
+    std::ofstream file(results_path, std::ios::app);
+    if (!(file << line << std::flush))
+        throw std::runtime_error("cannot write sweep results to " + results_path);
+    results[{cell_key, run}] = std::move(values);
+}
+
+std::vector<std::pair<std::size_t, unsigned int>> Sweep::missing_cells() const
+{
+    std::vector<std::pair<std::size_t, unsigned int>> cells;
+    for (std::size_t config = 0; config < configs.size(); ++config)
+        for (unsigned int run = 0; run < num_runs; ++run)
+            if (!has_result(config, run))
+                cells.emplace_back(config, run);
+    return cells;
+}
+
+std::size_t Sweep::run(RunExecutor::EnvironmentFactory make_env, RunExecutor::AgentFactory make_agent,
+                       const CellFunction& run_cell, const unsigned int num_threads)
+{
+    const auto cells = missing_cells();
+    run_work_stealing(cells.size(), num_threads, [&](const std::size_t task)
+    {
+        const std::size_t config = cells[task].first;
+        const unsigned int run = cells[task].second;
+        store_result(config, run, run_one(config, run, make_env, make_agent, run_cell));
+    });
+    return cells.size();
+}
+
+/* Cell (config, run) is claimed by creating <name>.lock in the queue
+ * directory and finished when <name>.cell appears; the shard is written
+ * under a name of this process first and renamed, so it appears whole.
+ */
+std::string Sweep::cell_path(const std::string& queue_dir, const std::size_t config, const unsigned int run) const
+{
+    // 64 bit FNV-1a of the key
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : keys[config])
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx-%u", static_cast<unsigned long long>(hash), run);
+    return queue_dir + "/" + name;
+}
+
+std::size_t Sweep::run_worker(const std::string& queue_dir,
+                              RunExecutor::EnvironmentFactory make_env, RunExecutor::AgentFactory make_agent,
+                              const CellFunction& run_cell, const unsigned int num_threads)
+{
+    if (::mkdir(queue_dir.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("cannot create " + queue_dir + ": " + std::strerror(errno));
+
+    const auto cells = missing_cells();
+    std::atomic<std::size_t> num_run{0};
+    run_work_stealing(cells.size(), num_threads, [&](const std::size_t task)
+    {
+        const std::size_t config = cells[task].first;
+        const unsigned int run = cells[task].second;
+        const std::string path = cell_path(queue_dir, config, run);
+        if (file_exists(path + ".cell") || !claim(path + ".lock"))
+            return;
+
+        const std::string line = format_cell(run, keys[config],
+                run_one(config, run, make_env, make_agent, run_cell));
+        const std::string part = path + ".part" + std::to_string(::getpid());
+        {
+            std::ofstream file(part);
+            if (!(file << line << std::flush))
+                throw std::runtime_error("cannot write " + part);
+        }
+        if (std::rename(part.c_str(), (path + ".cell").c_str()) != 0)
+            throw std::runtime_error("cannot rename " + part + ": " + std::strerror(errno));
+        ++num_run;
+    });
+    return num_run;
+}
+
+std::size_t Sweep::merge(const std::string& queue_dir)
+{
+    std::size_t num_missing = 0;
+    for (const auto& cell : missing_cells())
+    {
+        std::ifstream file(cell_path(queue_dir, cell.first, cell.second) + ".cell");
+        std::string line, cell_key;
+        unsigned int run;
+        std::vector<double> values;
+        if (std::getline(file, line) && !file.eof() && parse_cell(line, run, cell_key, values) &&
+            run == cell.second && cell_key == keys[cell.first])
+            store_result(cell.first, cell.second, std::move(values));
+        else
+            ++num_missing;
+    }
+    return num_missing;
+}
+
+bool Sweep::has_result(const std::size_t config, const unsigned int run) const
+{
+    return results.count({keys[config], run}) != 0;
+}
+
+const std::vector<double>& Sweep::get_result(const std::size_t config, const unsigned int run) const
+{
+    return results.at({keys[config], run});
+}
+
+} // rl
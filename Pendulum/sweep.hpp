@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "rl.hpp"
+#include "run_executor.hpp"
+
+namespace rl {
+
+/* Runs tasks 0 to num_tasks - 1 on num_threads threads (0 for one per
+ * hardware thread). Each thread starts with an even share of the tasks in a
+ * queue of its own, works through it from the front and, once it is empty,
+ * steals from the back of the next queue that has any left. Once all are
+ * done, the exception of the lowest numbered task that threw, if any, is
+ * rethrown.
+ */
+void run_work_stealing(const std::size_t num_tasks, unsigned int num_threads,
+                       const std::function<void(const std::size_t task)>& task);
+
+/* A parameter study read from a config file of lines
+ *
+ *     # comment
+ *     name = value, value, ...
+ *
+ * Every name but the sweep's own (mode, num_runs and results) is a
+ * parameter: an AgentInit field, see set_agent_param, or one of the settings
+ * the driver declares and reads with get_value. Any other name, or a value
+ * its field cannot take, is an error when the config is read, so a typo
+ * cannot pass for a setting nobody reads. With mode = grid, the default,
+ * there is a config for every combination of the values; with mode = list
+ * config i takes value i of each parameter, a single value going to every
+ * config.
+ * The fields a config leaves out keep the driver's defaults, completed by
+ * its AgentDefaults.
+ *
+ * Each config is run num_runs times, and each (config, run) cell is a task
+ * for run_work_stealing. Finished cells are appended to the results file, so
+ * a sweep that was stopped runs only the cells it is missing when started
+ * again. Cells are stored by what they ran with, not their position: the
+ * settings, every AgentInit field after the defaults are applied and the
+ * environment's seed. A study may grow between starts, and a cell whose
+ * parameters changed with the driver's defaults runs again instead of
+ * resuming from results of other parameters. Delete the results file to run
+ * a study afresh.
+ *
+ * Processes can share a sweep through a queue directory: each runs
+ * run_worker on it, and one merges the shards when all are done. A worker
+ * that dies leaves the lock of its cell behind; delete the .lock files that
+ * have no .cell file to run those cells again.
+ */
+class Sweep {
+public:
+    using Config = std::vector<std::pair<std::string, std::string>>;
+    // Runs one cell with rl initialized for config and run, returning its
+    // results
+    using CellFunction = std::function<std::vector<double>(RL& rl, const Config& config, const unsigned int run)>;
+
+    // Sets the fields of a config's AgentInit that follow from those the
+    // config sets, e.g. a step size scaled by its num_tilings
+    using AgentDefaults = std::function<void(AgentInit& agent_params, const Config& config)>;
+
+    // The fields a config leaves out take their values from agent_params,
+    // and every cell's environment is initialized from env_params
+    Sweep(const std::string& config_path, const EnvironmentInit& env_params, const AgentInit& agent_params,
+          const std::vector<std::string>& settings = {}, const AgentDefaults& agent_defaults = {});
+
+    std::size_t get_num_configs() const { return configs.size(); }
+    const Config& get_config(const std::size_t i) const { return configs[i]; }
+    unsigned int get_num_runs() const { return num_runs; }
+    const std::string& get_results_path() const { return results_path; }
+
+    // The value of name in config, or default_value if it has none
+    static std::string get_value(const Config& config, const std::string& name, const std::string& default_value);
+
+    // Runs the cells missing from the results file, each with an agent and
+    // environment of its own initialized for its config and run. Returns the
+    // number of cells run.
+    std::size_t run(RunExecutor::EnvironmentFactory make_env, RunExecutor::AgentFactory make_agent,
+                    const CellFunction& run_cell, const unsigned int num_threads = 0);
+
+    // Runs the cells missing from the results file that no other worker
+    // sharing queue_dir has claimed, e.g. processes on several machines with
+    // queue_dir on a shared file system, each cell leaving its results in a
+    // shard file of its own. Returns the number of cells run.
+    std::size_t run_worker(const std::string& queue_dir,
+                           RunExecutor::EnvironmentFactory make_env, RunExecutor::AgentFactory make_agent,
+                           const CellFunction& run_cell, const unsigned int num_threads = 0);
+    // Adds the finished shards of queue_dir to the results and the results
+    // file. Returns the number of cells still missing.
+    std::size_t merge(const std::string& queue_dir);
+
+    bool has_result(const std::size_t config, const unsigned int run) const;
+    const std::vector<double>& get_result(const std::size_t config, const unsigned int run) const;
+
+private:
+    std::vector<Config> configs;
+    unsigned int num_runs{1};
+    std::string results_path;
+    EnvironmentInit env_params;
+    std::vector<AgentInit> config_agent_params;  // of each config
+    std::vector<std::string> keys;               // of each config
+
+    std::map<std::pair<std::string, unsigned int>, std::vector<double>> results;
+    std::mutex results_mutex;
+
+    std::string key(const Config& config, const AgentInit& params) const;
+    void read_config(const std::string& config_path, const std::vector<std::string>& settings);
+    void read_results();
+    std::vector<std::pair<std::size_t, unsigned int>> missing_cells() const;
+    std::vector<double> run_one(const std::size_t config, const unsigned int run,
+                                const RunExecutor::EnvironmentFactory& make_env,
+                                const RunExecutor::AgentFactory& make_agent,
+                                const CellFunction& run_cell) const;
+    void store_result(const std::size_t config, const unsigned int run, std::vector<double> values);
+    std::string cell_path(const std::string& queue_dir, const std::size_t config, const unsigned int run) const;
+};
+
+} // rl
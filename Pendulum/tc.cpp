@@ -1,110 +1,79 @@
 
-#include <cmath>
-#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "tc.hpp"
 
 namespace tc
 {
 
-TileCoder::TileCoder(const std::size_t capacity)
-    : capacity(capacity)
-{
-}
+template class IndexHashTable<3>;
+template class TileCoder<2>;
+template class DenseTileCoder<2>;
+template class ConcurrentIndexHashTable<3>;
+template class MappedIndexHashTable<3>;
 
-TileCoder::TileCoder()
+static std::runtime_error file_error(const std::string& what, const std::string& path)
 {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
 }
 
-TileCoder::~TileCoder()
+MappedFile map_file(const std::string& path)
 {
-}
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw(file_error("cannot open", path));
 
-std::size_t TileCoder::get_size()
-{
-    return iht.size();
-}
-
-void TileCoder::set_capacity(const std::size_t _capacity)
-{
-    capacity = _capacity;
-}
-
-std::uint32_t TileCoder::get_index(const KeyType& k)
-{
-    auto search = iht.find(k);
-    if (search != iht.end())
-        return iht[k];
-
-    auto size = iht.size();
-    if (size >= capacity)
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
     {
-        if (overflow_count == 0)
-            std::printf("TileCoder: index hash table full, allowing collisions");
-        ++overflow_count;
-        //return KeyHash{}();
-        throw(std::out_of_range("TileCoder: index hash table full"));
+        ::close(fd);
+        throw(file_error("cannot stat", path));
     }
 
-    iht[k] = size;
-    return size;
-}
-
-std::vector<std::uint32_t> TileCoder::get_tiles(const std::uint32_t num_tilings, const std::vector<float>& floats)
-{
-    std::vector<uint32_t> tiles;
-    std::vector<int> qfloats;
-
-    for (const auto& f : floats)
-        qfloats.push_back(static_cast<int>(std::floor(f * num_tilings)));
-
-    for (std::uint32_t tiling=0; tiling < num_tilings; ++tiling)
+    MappedFile file;
+    file.size = static_cast<std::size_t>(st.st_size);
+    if (file.size > 0)
     {
-        auto tiling_x2 = tiling * 2;
-        auto b = tiling;
-
-        KeyType coords =  // TODO: make this a length-n tuple
-                std::make_tuple(
-                                    tiling,
-                                    (qfloats[0] + b) / num_tilings,
-                                    (qfloats[1] + b + tiling_x2) / num_tilings
-                               );
-
-        tiles.push_back(get_index(coords));
+        void* data = ::mmap(nullptr, file.size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            throw(file_error("cannot map", path));
+        }
+        file.data = data;
     }
 
-    return tiles;
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    return file;
 }
 
-std::vector<std::uint32_t> TileCoder::get_tileswrap(
-        const std::uint32_t num_tilings, const std::vector<float>& floats,
-        const std::vector<std::uint32_t>& wrap_widths)
+void unmap_file(MappedFile& file)
 {
-    std::vector<uint32_t> tiles;
-    std::vector<int> qfloats;
-
-    for (const auto& f : floats)
-        qfloats.push_back(static_cast<int>(std::floor(f * num_tilings)));
+    if (file.data)
+        ::munmap(const_cast<void*>(file.data), file.size);
+    file = MappedFile{};
+}
 
-    for (std::uint32_t tiling=0; tiling < num_tilings; ++tiling)
+/* Written to a temporary file and renamed into place, so a process mapping
+ * path never sees a partly written table.
+ */
+void write_file(const std::string& path, const std::vector<char>& contents)
+{
+    const std::string tmp_path = path + ".tmp";
     {
-        auto tiling_x2 = tiling * 2;
-        auto b = tiling;
-
-        std::uint32_t c0 = tiling;
-        std::uint32_t c1 = (qfloats[0] + b % num_tilings) / num_tilings;
-        if (wrap_widths[0] > 0)
-            c1 %= wrap_widths[0];
-        std::uint32_t c2 = (qfloats[1] + (b + tiling_x2) % num_tilings) / num_tilings;
-        if (wrap_widths[1] > 0)
-            c2 %= wrap_widths[1];
-
-        KeyType coords =  // TODO: make this a length-n tuple
-                std::make_tuple(c0, c1, c2);
-
-        tiles.push_back(get_index(coords));
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!out)
+            throw(file_error("cannot write", tmp_path));
     }
-
-    return tiles;
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw(file_error("cannot rename to", path));
 }
 
 } /* namespace tc */